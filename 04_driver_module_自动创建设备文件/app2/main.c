@@ -1,8 +1,8 @@
-﻿#include "heap_inl.h"
+﻿#include "event_loop_inl.h"
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
-#include <unistd.h>  // usleep
+#include <unistd.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -42,28 +42,6 @@ static void led_close(void)
     }
 }
 
-// 定义 container_of 宏
-#ifndef container_of
-# define container_of(ptr, type, member) \
-    ((type*)((char*)(ptr) - (size_t)&((type*)0)->member))
-#endif
-
-/* 任务调度结构体 */
-typedef struct TTaskControlBlock_t {
-    struct heap_node node;                              
-    int expire_time;                                    
-    int interval;
-    char name[16];
-    void (*callback)(struct TTaskControlBlock_t *);
-} TTaskControlBlock_t;
-
-// 比较函数
-int timer_less_than(const struct heap_node *a, const struct heap_node *b) {
-    const TTaskControlBlock_t *ta = container_of(a, TTaskControlBlock_t, node);
-    const TTaskControlBlock_t *tb = container_of(b, TTaskControlBlock_t, node);
-    return ta->expire_time < tb->expire_time;
-}
-
 // 任务A：写入 {1, 2, 3, 4, 5}
 void task_a_callback(TTaskControlBlock_t *t) {
     const unsigned char buf[] = {1, 2, 3, 4, 5};
@@ -103,20 +81,6 @@ void task_c_callback(TTaskControlBlock_t *t) {
     //fflush(stdout);
 }
 
-// 重新调度周期任务
-void reschedule_timer(struct heap *heap, TTaskControlBlock_t *timer, int current_time) {
-    heap_remove(heap, &timer->node, timer_less_than);
-    timer->expire_time = current_time + timer->interval;
-    heap_insert(heap, &timer->node, timer_less_than);
-}
-
-// 获取当前时间（毫秒）
-int get_current_time_ms() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (int)(ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL);
-}
-
 int main() {
     // Step 1: 初始化 LED 设备
     if (led_init(LED_DEVICE) != 0) {
@@ -124,54 +88,52 @@ int main() {
         return EXIT_FAILURE;
     }
 
-    // Step 2: 初始化堆结构
-    struct heap timer_heap;
-    heap_init(&timer_heap);
+    // Step 2: 初始化任务调度器
+    TScheduler_t sched;
+    unsigned long long now = get_current_time_ns();
+    sched_init(&sched, now);
+
+    // 打开任务统计：kill -USR1 <pid> 输出迟到时间和回调耗时，设置环境变量 SCHED_STATS_FILE 则追加写入该文件
+    sched_enable_stats(&sched);
 
     // Step 3: 创建定时器任务
     TTaskControlBlock_t t1 = {0};
-    t1.expire_time = 1000;
-    t1.interval = 1000;
+    t1.expire_time = now + SCHED_MS(1000);
+    t1.interval = SCHED_MS(1000);
     strcpy(t1.name, "LED_Write_12345");
     t1.callback = task_a_callback;
 
     TTaskControlBlock_t t2 = {0};
-    t2.expire_time = 2000;
-    t2.interval = 2000;
+    t2.expire_time = now + SCHED_MS(2000);
+    t2.interval = SCHED_MS(2000);
     strcpy(t2.name, "LED_Write_1122334455");
     t2.callback = task_b_callback;
 
     TTaskControlBlock_t t3 = {0};
-    t3.expire_time = 1500;
-    t3.interval = 1500;
+    t3.expire_time = now + SCHED_MS(1500);
+    t3.interval = SCHED_MS(1500);
     strcpy(t3.name, "LED_Write_111222333444555");
     t3.callback = task_c_callback;
 
-    /**将任务插入到最小堆中 */
-    heap_insert(&timer_heap, &t1.node, timer_less_than);
-    heap_insert(&timer_heap, &t2.node, timer_less_than);
-    heap_insert(&timer_heap, &t3.node, timer_less_than);
+    /**将任务加入调度器 */
+    sched_add_task(&sched, &t1);
+    sched_add_task(&sched, &t2);
+    sched_add_task(&sched, &t3);
 
     printf("LED定时控制任务启动！按 Ctrl+C 停止。\n\n");
     fflush(stdout);
 
-    // 主循环
-    while (1) {
-        int current_time = get_current_time_ms();
-
-        while (heap_min(&timer_heap) != NULL) {
-            TTaskControlBlock_t *timer = container_of(heap_min(&timer_heap), TTaskControlBlock_t, node);
-
-            if (timer->expire_time <= current_time) {
-                timer->callback(timer);
-                reschedule_timer(&timer_heap, timer, current_time);
-            } else {
-                break;
-            }
-        }
-
-        //usleep(10000); // 休眠 10ms
+    // 主循环：阻塞到下一个任务到期，空闲时不占用 CPU
+    TEventLoop_t loop;
+    if (event_loop_init(&loop, &sched) < 0) {
+        perror("event_loop_init");
+        led_close();
+        return EXIT_FAILURE;
     }
+    if (event_loop_dump_stats_on_signal(&loop, SIGUSR1, getenv("SCHED_STATS_FILE")) < 0)
+        perror("event_loop_dump_stats_on_signal");
+    event_loop_run(&loop);
+    event_loop_close(&loop);
 
     // 正常情况下不会到这里，但建议加信号处理
     led_close();
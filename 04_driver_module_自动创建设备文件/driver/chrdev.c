@@ -18,6 +18,9 @@
 #include <linux/types.h>
 #include <linux/device.h>
 
+#include "drv_stats.h"
+#define CREATE_TRACE_POINTS
+#include "led04_trace.h"
 
 #define BUF_SIZE    5                   // 接收应用层数据的个数
 static char dataBuf[BUF_SIZE];
@@ -30,6 +33,16 @@ static dev_t dev_no;
 struct class *pClassLed;
 struct device *pDeviceLed;
 
+/**debugfs 计数器：/sys/kernel/debug/led04/stats */
+enum {
+    LED_STAT_WRITES = 0,
+    LED_STAT_BYTES,
+    LED_STAT_ERRORS,
+    LED_STAT_NUM
+};
+static const char *const led_stat_names[LED_STAT_NUM] = { "writes", "bytes", "errors" };
+static struct drv_stats led_stats;
+
 static int led_open(struct inode *inode, struct file *pFile)
 {
     /**硬件初始化 */
@@ -57,13 +70,18 @@ static ssize_t led_write(struct file *file, const char __user *buf, size_t len,
     // 从用户空间复制数据到内核空间
     ret = copy_from_user(dataBuf, buf, len);
     if (ret != 0) {
-        printk(KERN_ERR "led_write: copy_from_user failed, %d bytes not copied\n", ret);
+        drv_stats_inc(&led_stats, LED_STAT_ERRORS);
+        pr_debug("led_write: copy_from_user failed, %d bytes not copied\n", ret);
         return -EFAULT;
     }
-    printk(KERN_INFO "led_write: received %zu bytes: %.*s\n", len, (int)len, dataBuf);
+
+    // 热路径上不打印，按字节记录跟踪点，需要时打开 led04 事件
     for(i = 0; i < len; i++){
-        printk(KERN_INFO "received [%d]: %d\n", i, *(dataBuf + i));
+        trace_led04_write("SelfDeviceName", -1, dataBuf[i]);
     }
+    drv_stats_inc(&led_stats, LED_STAT_WRITES);
+    drv_stats_add(&led_stats, LED_STAT_BYTES, len);
+    pr_debug("led_write: received %zu bytes\n", len);
 
     return len; // 返回成功写入的字节数
 }
@@ -112,6 +130,7 @@ static int __init chrDevInit(void)
         goto err_cdev_add;
     }
 
+    drv_stats_init(&led_stats, "led04", led_stat_names, LED_STAT_NUM);
     printk("<6>char device add success\n");
     return 0;
 
@@ -123,6 +142,8 @@ err_cdev_add:
 
 static void __exit chrDevExit(void)
 {
+    drv_stats_exit(&led_stats);
+
     /**0.自动销毁设备文件 */
     device_destroy(pClassLed, dev_no);
     class_destroy(pClassLed);
@@ -147,4 +168,7 @@ MODULE_VERSION("2025-08-31_V1.0");
  * 改动历史纪录：
  * Revision 1.0, 2025-08-31, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 写路径上的 printk 改为 led04_write 跟踪点与 pr_debug，
+ *           增加 debugfs 计数器 /sys/kernel/debug/led04/stats.
  *************************************************************************/
\ No newline at end of file
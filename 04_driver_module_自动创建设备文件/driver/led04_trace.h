@@ -0,0 +1,60 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: led04_trace.h
+ *   软件模块: 跟踪点
+ *   功    能: LED 字符设备驱动的 tracepoint，字段统一为 dev/pin/value/ts，
+ *             ts 为 CLOCK_MONOTONIC 纳秒，可直接与应用层的时间对齐。
+ *             默认关闭，几乎没有开销；需要时：
+ *             echo 1 > /sys/kernel/debug/tracing/events/led04/enable
+ *             cat /sys/kernel/debug/tracing/trace_pipe
+ *             或 perf record -e 'led04:*'
+ *
+ ************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM led04
+
+#if !defined(LED04_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define LED04_TRACE_H_
+
+#include <linux/tracepoint.h>
+#include <linux/ktime.h>
+
+/**
+ * dev   设备名
+ * pin   本驱动没有硬件，固定为 -1
+ * value 写入的字节值
+ */
+DECLARE_EVENT_CLASS(led04_pin_class,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value),
+    TP_STRUCT__entry(
+        __string(dev, dev)
+        __field(int, pin)
+        __field(int, value)
+        __field(u64, ts)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev);
+        __entry->pin = pin;
+        __entry->value = value;
+        __entry->ts = ktime_to_ns(ktime_get());
+    ),
+    TP_printk("dev=%s pin=%d value=%d ts=%llu",
+              __get_str(dev), __entry->pin, __entry->value,
+              (unsigned long long)__entry->ts)
+);
+
+/**每写入一个字节一个事件 */
+DEFINE_EVENT(led04_pin_class, led04_write,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+#endif  /* LED04_TRACE_H_ */
+
+/* 跟踪头文件在驱动目录下，Makefile 中需要 CFLAGS_xxx.o := -I$(src) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE led04_trace
+#include <trace/define_trace.h>
@@ -1,6 +1,14 @@
 ﻿#ifndef UV_SRC_HEAP_H_
 #define UV_SRC_HEAP_H_
  
+/* Compile with -DHEAP_USE_ARRAY to get the array backed d-ary heap from
+ * heap_array_inl.h instead.  Both provide the same heap_init/heap_min/
+ * heap_insert/heap_remove/heap_dequeue API, callers do not change.
+ */
+#if defined(HEAP_USE_ARRAY)
+# include "heap_array_inl.h"
+#else
+ 
 #include <stddef.h>
  
 #if defined(__GNUC__)
@@ -231,4 +239,6 @@ HEAP_EXPORT(void heap_dequeue(struct heap *heap, heap_compare_fn less_than)) {
  
 #undef HEAP_EXPORT
  
+#endif  /* HEAP_USE_ARRAY */
+ 
 #endif  /* UV_SRC_HEAP_H_ */
\ No newline at end of file
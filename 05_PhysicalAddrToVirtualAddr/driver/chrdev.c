@@ -19,6 +19,10 @@
 #include <linux/device.h>
 #include <linux/io.h>
 
+#include "drv_stats.h"
+#define CREATE_TRACE_POINTS
+#include "led05_trace.h"
+
 #define BUF_SIZE    5                   // 接收应用层数据的个数
 static char dataBuf[BUF_SIZE];
 
@@ -38,6 +42,18 @@ static struct resource *GPIOEOUT_RES;
 static unsigned int *GPIOEOUT_VA;        // 输出数据寄存器的虚拟地址
 static unsigned int *GPIOEOUTENB_VA;     // 输出使能寄存器的虚拟地址
 
+#define LED_GPIO_NUM    (4 * 32 + 13)   // GPIOE13 的全局 GPIO 编号，仅用于跟踪点
+
+/**debugfs 计数器：/sys/kernel/debug/led05/stats */
+enum {
+    LED_STAT_WRITES = 0,
+    LED_STAT_BYTES,
+    LED_STAT_ERRORS,
+    LED_STAT_NUM
+};
+static const char *const led_stat_names[LED_STAT_NUM] = { "writes", "bytes", "errors" };
+static struct drv_stats led_stats;
+
 static int led_open(struct inode *inode, struct file *pFile)
 {
     unsigned int temp;
@@ -71,34 +87,39 @@ static int led_close(struct inode *inode, struct file *pFile)
 static ssize_t led_write(struct file *file, const char __user *buf, size_t len, loff_t *off) 
 {
     int ret;
-    int i;
 
     // 限制写入长度，防止溢出
     if (len > BUF_SIZE) {
         len = BUF_SIZE;
     }
+    if (len == 0) {
+        return 0;
+    }
 
     /**将用户空间的数据复制到内核空间 */
     ret = copy_from_user(dataBuf, buf, len);
     if (ret != 0) {
-        printk(KERN_ERR "led_write: copy_from_user failed, %d bytes not copied\n", ret);
+        drv_stats_inc(&led_stats, LED_STAT_ERRORS);
+        pr_debug("led_write: copy_from_user failed, %d bytes not copied\n", ret);
         return -EFAULT;
     }
-    printk(KERN_INFO "led_write: received %zu bytes: %.*s\n", len, (int)len, dataBuf);
-    for(i = 0; i < len; i++){
-        printk(KERN_INFO "received [%d]: %d\n", i, *(dataBuf + i));
-    }
 
-    /**关灯 */
-    if(buf[0] == '1'){
+    /**关灯，只能使用复制到内核的 dataBuf，buf 是用户空间指针 */
+    if(dataBuf[0] == '1'){
         *GPIOEOUT_VA |= (1 << 13);
+        trace_led05_write("SelfDeviceName", LED_GPIO_NUM, 1);
     }
     
     /**开灯 */
-    if(buf[0] == '0'){
+    if(dataBuf[0] == '0'){
         *GPIOEOUT_VA &= ~(1 << 13);
+        trace_led05_write("SelfDeviceName", LED_GPIO_NUM, 0);
     }
 
+    drv_stats_inc(&led_stats, LED_STAT_WRITES);
+    drv_stats_add(&led_stats, LED_STAT_BYTES, len);
+    pr_debug("led_write: received %zu bytes\n", len);
+
     return len; // 返回成功写入的字节数
 }
 
@@ -166,6 +187,7 @@ static int __init chrDevInit(void)
         goto device_create_failed;
     }
 
+    drv_stats_init(&led_stats, "led05", led_stat_names, LED_STAT_NUM);
     printk("<6>char device init success\n");
     return 0;
 
@@ -189,6 +211,8 @@ err_cdev_add:
 
 static void __exit chrDevExit(void)
 {
+    drv_stats_exit(&led_stats);
+
     /**0.自动销毁设备文件 */
     device_destroy(pClassLed, dev_no);
 
@@ -221,4 +245,8 @@ MODULE_VERSION("2025-08-31_V1.0");
  * 改动历史纪录：
  * Revision 1.0, 2025-08-31, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 写路径上的 printk 改为 led05_write 跟踪点与 pr_debug，
+ *           增加 debugfs 计数器 /sys/kernel/debug/led05/stats；
+ *           修正 led_write 直接解引用用户空间指针 buf 的问题.
  *************************************************************************/
\ No newline at end of file
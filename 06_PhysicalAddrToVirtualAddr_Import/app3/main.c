@@ -0,0 +1,115 @@
+﻿/*************************************************************************
+ *
+ *   Copyright (C), 2017-2037, BPG. Co., Ltd.
+ *
+ *   文件名称: main.c
+ *   软件模块: GPIO 寄存器 mmap 演示
+ *   版 本 号: 1.0
+ *   生成日期: 2026-10-17
+ *   作    者: lium
+ *   功    能: 通过 /dev/LEDE 的 mmap 直接读写 GPIOXOUT 翻转 LED，
+ *             每次翻转不经过系统调用，最后打印平均每次翻转的耗时。
+ *             需要 root(CAP_SYS_RAWIO)。用法: ./zsf06m [灯序号 0~3] [翻转次数]
+ ************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+
+#define LED_DEVICE "/dev/LEDE"
+
+#define LED_NUM         4
+#define LED_MASK_ALL    ((1U << LED_NUM) - 1)
+
+/**与驱动中的定义一致 */
+struct led_batch {
+    unsigned int mask;
+    unsigned int value;
+};
+
+struct led_map_info {
+    unsigned int nleds;
+    struct {
+        unsigned int map_offset;
+        unsigned int reg_offset;
+        unsigned int pin;
+    } leds[LED_NUM];
+};
+
+#define LED_MAGIC               'L'
+#define LED_IOCTL_SET_BATCH     _IOW(LED_MAGIC, 0, struct led_batch)
+#define LED_IOCTL_GET_MAP_INFO  _IOR(LED_MAGIC, 4, struct led_map_info)
+
+#define GPIOXOUT_OFFSET 0x00            // GPIOXOUT 在 GPIO_TypeDef 中的偏移
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    struct led_map_info info;
+    struct led_batch off = { LED_MASK_ALL, LED_MASK_ALL };
+    volatile uint32_t *out;
+    unsigned long long start;
+    unsigned long long elapsed;
+    unsigned int led = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 0) : 0;
+    unsigned int count = (argc > 2) ? (unsigned int)strtoul(argv[2], NULL, 0) : 1000000;
+    unsigned int bit;
+    unsigned int i;
+    long page = sysconf(_SC_PAGESIZE);
+    void *base;
+    int fd;
+
+    if (led >= LED_NUM || count == 0) {
+        fprintf(stderr, "usage: %s [led 0~3] [toggles]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    fd = open(LED_DEVICE, O_RDWR | O_SYNC);
+    if (fd < 0) {
+        perror("open");
+        fprintf(stderr, "Failed to open device: %s\n", LED_DEVICE);
+        return EXIT_FAILURE;
+    }
+
+    if (ioctl(fd, LED_IOCTL_GET_MAP_INFO, &info) < 0) {
+        perror("ioctl [LED_IOCTL_GET_MAP_INFO]");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    base = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, info.leds[led].map_offset);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    out = (volatile uint32_t *)((char *)base + info.leds[led].reg_offset + GPIOXOUT_OFFSET);
+    bit = 1U << info.leds[led].pin;
+
+    // 每次翻转只有一次读和一次写 MMIO，没有系统调用
+    start = now_ns();
+    for (i = 0; i < count; i++)
+        *out ^= bit;
+    elapsed = now_ns() - start;
+
+    printf("LED%u: %u toggles in %llu us, %.1f ns/toggle\n",
+           led, count, elapsed / 1000, (double)elapsed / count);
+
+    munmap(base, page);
+    ioctl(fd, LED_IOCTL_SET_BATCH, &off);
+    close(fd);
+    return 0;
+}
+/*************************************************************************
+ * 改动历史纪录：
+ * Revision 1.0, 2026-10-17, lium
+ * describe: 初始创建.
+ *************************************************************************/
@@ -8,6 +8,11 @@
  *   生成日期: 2025-09-08
  *   作    者: lium
  *   功    能: 应用层控制LED（通过GPIOE[13]）
+ *             LED_IOCTL_SET_BATCH 按 mask/value 同时设置 4 盏灯(E13/C17/C8/C7)：
+ *             请求的引脚按 bank 分组，每个 bank 在自旋锁内只写一次 GPIOXOUT，
+ *             4 盏灯最多 2 次 MMIO 写，同一 bank 上的灯同时变化。
+ *             mmap：把 GPIOC/GPIOE 的寄存器页映射到用户空间，应用层直接读写
+ *             GPIOXOUT，每次翻转无需系统调用；映射位置由 LED_IOCTL_GET_MAP_INFO 查询。
  *
  ************************************************************************/
 
@@ -20,6 +25,14 @@
 #include <linux/device.h>
 #include <linux/io.h>
 #include <linux/string.h>
+#include <linux/ioctl.h>
+#include <linux/spinlock.h>
+#include <linux/mm.h>
+#include <linux/capability.h>
+
+#include "drv_stats.h"
+#define CREATE_TRACE_POINTS
+#include "led06_trace.h"
 
 #define BUF_SIZE    5                   // 接收应用层数据的个数
 static char dataBuf[BUF_SIZE];
@@ -76,30 +89,162 @@ typedef struct {
 #define GPIOD           ((GPIO_TypeDef *) GPIOD_BASE)
 #define GPIOE           ((GPIO_TypeDef *) GPIOE_BASE)
 
-// 虚拟地址指针
-static volatile GPIO_TypeDef *GPIOE_VA = NULL;
-static struct resource *GPIOE_RES = NULL;
+/**本驱动用到的 bank */
+enum {
+    LED_BANK_C = 0,
+    LED_BANK_E,
+    LED_BANK_NUM
+};
+
+typedef struct {
+    const char *name;                   // request_mem_region 使用的名称
+    unsigned long phys;                 // 物理基地址
+    volatile GPIO_TypeDef *va;          // ioremap 之后的虚拟地址
+    struct resource *res;
+} TGpioBank_t;
+
+static TGpioBank_t led_banks[LED_BANK_NUM] = {
+    [LED_BANK_C] = { "gpioc_region", GPIOC_BASE, NULL, NULL },
+    [LED_BANK_E] = { "gpioe_region", GPIOE_BASE, NULL, NULL },
+};
+
+/**每盏灯所在的 bank、引脚号及作为 GPIO 时的复用功能号 */
+typedef struct {
+    unsigned int bank;
+    unsigned int pin;
+    unsigned int altfn;
+} TLedPin_t;
+
+#define LED_NUM         4
+#define LED_MASK_ALL    ((1U << LED_NUM) - 1)
+
+static const TLedPin_t led_pins[LED_NUM] = {
+    { LED_BANK_E, 13, 0 },              // LED0: GPIOE13
+    { LED_BANK_C, 17, 1 },              // LED1: GPIOC17
+    { LED_BANK_C,  8, 1 },              // LED2: GPIOC8
+    { LED_BANK_C,  7, 1 },              // LED3: GPIOC7
+};
+
+/**第 i 盏灯的全局 GPIO 编号(bank 序号 * 32 + 引脚号)，仅用于跟踪点 */
+#define LED_GPIO_NUM(i) \
+    ((int)((led_banks[led_pins[i].bank].phys - GPIOA_BASE) / 0x1000 * 32 + led_pins[i].pin))
+
+/**debugfs 计数器：/sys/kernel/debug/led06/stats */
+enum {
+    LED_STAT_WRITES = 0,
+    LED_STAT_IOCTLS,
+    LED_STAT_PIN_SETS,
+    LED_STAT_ERRORS,
+    LED_STAT_NUM
+};
+static const char *const led_stat_names[LED_STAT_NUM] = { "writes", "ioctls", "pin_sets", "errors" };
+static struct drv_stats led_stats;
+
+/**
+ * 批量设置：mask 的第 i 位为 1 表示设置第 i 盏灯，value 的第 i 位为该灯的电平
+ * (与 write 中的状态一致，0 亮 1 灭)
+ */
+struct led_batch {
+    unsigned int mask;
+    unsigned int value;
+};
+
+#define LED_MAGIC           'L'
+#define LED_IOCTL_SET_BATCH _IOW(LED_MAGIC, 0, struct led_batch)   // 按 mask/value 设置
+
+/**
+ * mmap 信息：第 i 盏灯所在 bank 的寄存器页用 mmap(..., leds[i].map_offset) 映射，
+ * GPIO_TypeDef 位于页内 reg_offset 处，GPIOXOUT 的第 pin 位即该灯的电平。
+ */
+struct led_map_info {
+    unsigned int nleds;
+    struct {
+        unsigned int map_offset;        // 传给 mmap 的 offset(字节)
+        unsigned int reg_offset;        // 寄存器在页内的偏移
+        unsigned int pin;               // 在 GPIOXOUT 中的位
+    } leds[LED_NUM];
+};
+
+#define LED_IOCTL_GET_MAP_INFO _IOR(LED_MAGIC, 4, struct led_map_info)
+
+static DEFINE_SPINLOCK(led_lock);       // 保护所有 bank 的 GPIOXOUT 读-改-写
 
 /**
- * @brief 打开设备：配置 GPIOE[13] 为输出
+ * @brief 按 bank 分组后设置多盏灯，每个 bank 只读写一次 GPIOXOUT
+ * @param mask  第 i 位为 1 表示设置第 i 盏灯
+ * @param value 第 i 位为第 i 盏灯的电平
+ */
+static void led_apply(unsigned int mask, unsigned int value)
+{
+    unsigned int bank_mask[LED_BANK_NUM] = { 0 };
+    unsigned int bank_value[LED_BANK_NUM] = { 0 };
+    volatile unsigned int *out;
+    unsigned long flags;
+    unsigned int bit;
+    int i;
+
+    for (i = 0; i < LED_NUM; i++) {
+        if (!(mask & (1U << i)))
+            continue;
+        bit = 1U << led_pins[i].pin;
+        bank_mask[led_pins[i].bank] |= bit;
+        if (value & (1U << i))
+            bank_value[led_pins[i].bank] |= bit;
+    }
+
+    spin_lock_irqsave(&led_lock, flags);
+    for (i = 0; i < LED_BANK_NUM; i++) {
+        if (bank_mask[i] == 0)
+            continue;
+        out = &led_banks[i].va->GPIOXOUT;
+        iowrite32((ioread32(out) & ~bank_mask[i]) | bank_value[i], out);
+    }
+    spin_unlock_irqrestore(&led_lock, flags);
+
+    for (i = 0; i < LED_NUM; i++) {
+        if (!(mask & (1U << i)))
+            continue;
+        drv_stats_inc(&led_stats, LED_STAT_PIN_SETS);
+        trace_led06_write("LEDE", LED_GPIO_NUM(i), !!(value & (1U << i)));
+    }
+}
+
+/**
+ * @brief 打开设备：配置 4 盏灯的引脚为 GPIO 输出
  */
 static int led_open(struct inode *inode, struct file *pFile)
 {
+    volatile GPIO_TypeDef *gpio;
+    volatile unsigned int *altfn;
+    unsigned long flags;
     unsigned int reg;
+    unsigned int shift;
+    int i;
 
     printk(KERN_INFO "Led Open start!\n");
 
-    // 使能 GPIOE[13] 输出功能
-    reg = ioread32(&GPIOE_VA->GPIOXOUTENB);
-    reg |= (1 << 13);
-    iowrite32(reg, &GPIOE_VA->GPIOXOUTENB);
+    // 初始状态：关闭 LED（高电平关灯），先写输出值再使能输出，避免闪一下
+    led_apply(LED_MASK_ALL, LED_MASK_ALL);
+
+    spin_lock_irqsave(&led_lock, flags);
+    for (i = 0; i < LED_NUM; i++) {
+        gpio = led_banks[led_pins[i].bank].va;
+
+        // 选择 GPIO 功能，每个引脚占 2 位，0~15 在 ALTFN0，16~31 在 ALTFN1
+        altfn = (led_pins[i].pin < 16) ? &gpio->GPIOXALTFN0 : &gpio->GPIOXALTFN1;
+        shift = (led_pins[i].pin % 16) * 2;
+        reg = ioread32(altfn);
+        reg = (reg & ~(3U << shift)) | (led_pins[i].altfn << shift);
+        iowrite32(reg, altfn);
 
-    // 初始状态：关闭 LED（高电平关灯）
-    reg = ioread32(&GPIOE_VA->GPIOXOUT);
-    reg |= (1 << 13);
-    iowrite32(reg, &GPIOE_VA->GPIOXOUT);
+        // 使能输出功能
+        reg = ioread32(&gpio->GPIOXOUTENB);
+        reg |= (1U << led_pins[i].pin);
+        iowrite32(reg, &gpio->GPIOXOUTENB);
+    }
+    spin_unlock_irqrestore(&led_lock, flags);
 
-    printk(KERN_INFO "Led Open success! GPIOE[13] configured as output.\n");
+    printk(KERN_INFO "Led Open success! GPIOE[13] GPIOC[17,8,7] configured as output.\n");
     return 0;
 }
 
@@ -119,42 +264,99 @@ static int led_close(struct inode *inode, struct file *pFile)
 static ssize_t led_write(struct file *file, const char __user *buf, size_t len, loff_t *off)
 {
     int ret;
-    int i;
     size_t copy_len = len;
 
     // 限制长度
     if (copy_len > BUF_SIZE)
         copy_len = BUF_SIZE;
+    if (copy_len == 0)
+        return 0;
 
     // 复制用户数据
     ret = copy_from_user(dataBuf, buf, copy_len);
     if (ret != 0) {
-        printk(KERN_ERR "led_write: copy_from_user failed, %d bytes not copied\n", ret);
+        drv_stats_inc(&led_stats, LED_STAT_ERRORS);
+        pr_debug("led_write: copy_from_user failed, %d bytes not copied\n", ret);
         return -EFAULT;
     }
+    drv_stats_inc(&led_stats, LED_STAT_WRITES);
 
-    // 打印接收到的数据
-    printk(KERN_INFO "led_write: received %zu bytes: %.*s\n", copy_len, (int)copy_len, dataBuf);
-    for (i = 0; i < copy_len; i++) {
-        printk(KERN_INFO "received [%d]: '%c' (0x%02X)\n", i, dataBuf[i], dataBuf[i]);
-    }
-
-    // 控制LED
+    // 控制LED0(GPIOE[13])，电平变化由 led06_write 跟踪点记录
     if (dataBuf[0] == '1') {
         // 关灯：输出高电平
-        iowrite32(ioread32(&GPIOE_VA->GPIOXOUT) | (1 << 13), &GPIOE_VA->GPIOXOUT);
-        printk(KERN_INFO "LED OFF\n");
+        led_apply(1U << 0, 1U << 0);
     } else if (dataBuf[0] == '0') {
         // 开灯：输出低电平
-        iowrite32(ioread32(&GPIOE_VA->GPIOXOUT) & ~(1 << 13), &GPIOE_VA->GPIOXOUT);
-        printk(KERN_INFO "LED ON\n");
+        led_apply(1U << 0, 0);
     } else {
-        printk(KERN_WARNING "led_write: unknown command '%c'\n", dataBuf[0]);
+        drv_stats_inc(&led_stats, LED_STAT_ERRORS);
+        pr_debug("led_write: unknown command '%c'\n", dataBuf[0]);
     }
 
     return len;
 }
 
+/**
+ * @brief LED_IOCTL_SET_BATCH 一次系统调用设置多盏灯，LED_IOCTL_GET_MAP_INFO 查询 mmap 位置
+ */
+static long led_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct led_batch batch;
+    struct led_map_info info;
+    int i;
+
+    drv_stats_inc(&led_stats, LED_STAT_IOCTLS);
+    switch (cmd) {
+        case LED_IOCTL_SET_BATCH:
+            if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+                return -EFAULT;
+            if (batch.mask & ~LED_MASK_ALL)
+                return -EINVAL;
+            led_apply(batch.mask, batch.value);
+            break;
+        case LED_IOCTL_GET_MAP_INFO:
+            memset(&info, 0, sizeof(info));
+            info.nleds = LED_NUM;
+            for (i = 0; i < LED_NUM; i++) {
+                info.leds[i].map_offset = led_pins[i].bank << PAGE_SHIFT;
+                info.leds[i].reg_offset = led_banks[led_pins[i].bank].phys & ~PAGE_MASK;
+                info.leds[i].pin = led_pins[i].pin;
+            }
+            if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+                return -EFAULT;
+            break;
+        default:
+            return -ENOTTY;
+    }
+    return 0;
+}
+
+/**
+ * @brief 把一个 bank 的寄存器页映射到用户空间，offset 为 bank 序号 * PAGE_SIZE
+ *        MMU 只能按页保护，无法只开放驱动拥有的几个引脚：页内同一 bank 的其他
+ *        引脚同样可写，所以要求 CAP_SYS_RAWIO。用户空间对 GPIOXOUT 的读-改-写
+ *        不经过 led_lock，使用映射期间不要再同时调用 write/ioctl 改同一个 bank。
+ */
+static int led_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    unsigned long size = vma->vm_end - vma->vm_start;
+    unsigned long bank = vma->vm_pgoff;
+
+    if (!capable(CAP_SYS_RAWIO))
+        return -EPERM;
+    if (bank >= LED_BANK_NUM || size != PAGE_SIZE)
+        return -EINVAL;
+    if (!(vma->vm_flags & VM_SHARED))
+        return -EINVAL;
+
+    vma->vm_flags |= VM_IO | VM_RESERVED | VM_DONTEXPAND;
+    vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+
+    return remap_pfn_range(vma, vma->vm_start,
+                           led_banks[bank].phys >> PAGE_SHIFT,
+                           PAGE_SIZE, vma->vm_page_prot);
+}
+
 /**
  * @brief 文件操作集
  */
@@ -163,8 +365,59 @@ static const struct file_operations led_fops = {
     .open       = led_open,
     .release    = led_close,
     .write      = led_write,
+    .unlocked_ioctl = led_ioctl,
+    .mmap       = led_mmap,
 };
 
+/**
+ * @brief 释放已经映射的 bank
+ */
+static void led_unmap_banks(void)
+{
+    int i;
+
+    for (i = 0; i < LED_BANK_NUM; i++) {
+        if (led_banks[i].va) {
+            iounmap((void __iomem *)led_banks[i].va);
+            led_banks[i].va = NULL;
+        }
+        if (led_banks[i].res) {
+            release_mem_region(led_banks[i].phys, GPIO_MAP_SIZE);
+            led_banks[i].res = NULL;
+        }
+    }
+}
+
+/**
+ * @brief 请求并映射 GPIOC、GPIOE 的寄存器
+ */
+static int led_map_banks(void)
+{
+    TGpioBank_t *bank;
+    int i;
+
+    for (i = 0; i < LED_BANK_NUM; i++) {
+        bank = &led_banks[i];
+
+        bank->res = request_mem_region(bank->phys, GPIO_MAP_SIZE, bank->name);
+        if (!bank->res) {
+            printk(KERN_ERR "request_mem_region failed for %s\n", bank->name);
+            led_unmap_banks();
+            return -EBUSY;
+        }
+
+        bank->va = (volatile GPIO_TypeDef *)ioremap(bank->phys, GPIO_MAP_SIZE);
+        if (!bank->va) {
+            printk(KERN_ERR "ioremap failed for %s\n", bank->name);
+            led_unmap_banks();
+            return -EBUSY;
+        }
+
+        printk(KERN_INFO "%s mapped: PA=0x%08lX VA=%p\n", bank->name, bank->phys, (void*)bank->va);
+    }
+    return 0;
+}
+
 /**
  * @brief 驱动初始化
  */
@@ -196,22 +449,10 @@ static int __init chrDevInit(void)
         goto err_cdev_add;
     }
 
-    // 4. 请求并映射 GPIOE 内存区域
-    GPIOE_RES = request_mem_region((unsigned long)GPIOE, GPIO_MAP_SIZE, "gpioe_region");
-    if (!GPIOE_RES) {
-        printk(KERN_ERR "request_mem_region failed for GPIOE\n");
-        ret = -EBUSY;
+    // 4. 请求并映射 GPIOC、GPIOE 内存区域
+    ret = led_map_banks();
+    if (ret < 0)
         goto err_request_mem;
-    }
-
-    GPIOE_VA = (volatile GPIO_TypeDef *)ioremap((unsigned long)GPIOE, GPIO_MAP_SIZE);
-    if (!GPIOE_VA) {
-        printk(KERN_ERR "ioremap failed for GPIOE\n");
-        ret = -EBUSY;
-        goto err_ioremap;
-    }
-
-    printk(KERN_INFO "GPIOE mapped: PA=0x%08X VA=%p\n", (unsigned int)GPIOE_BASE, (void*)GPIOE_VA);
 
     // 5. 自动创建设备文件
     pClassLed = class_create(THIS_MODULE, "led_class");
@@ -230,15 +471,14 @@ static int __init chrDevInit(void)
         goto err_device_create;
     }
 
+    drv_stats_init(&led_stats, "led06", led_stat_names, LED_STAT_NUM);
     printk(KERN_INFO "LED driver initialized successfully (major=%d)\n", majorDevID);
     return 0;
 
 err_device_create:
     class_destroy(pClassLed);
 err_class_create:
-    iounmap((void __iomem *)GPIOE_VA);
-err_ioremap:
-    release_mem_region(GPIOE_BASE, GPIO_MAP_SIZE);
+    led_unmap_banks();
 err_request_mem:
     cdev_del(&chrdev);
 err_cdev_add:
@@ -251,6 +491,8 @@ err_cdev_add:
  */
 static void __exit chrDevExit(void)
 {
+    drv_stats_exit(&led_stats);
+
     if (pDeviceLed)
         device_destroy(pClassLed, dev_no);
 
@@ -260,15 +502,7 @@ static void __exit chrDevExit(void)
     cdev_del(&chrdev);
     unregister_chrdev_region(dev_no, 1);
 
-    if (GPIOE_VA) {
-        iounmap((void __iomem *)GPIOE_VA);
-        GPIOE_VA = NULL;
-    }
-
-    if (GPIOE_RES) {
-        release_mem_region(GPIOE_BASE, GPIO_MAP_SIZE);
-        GPIOE_RES = NULL;
-    }
+    led_unmap_banks();
 
     printk(KERN_INFO "chrDevExit: LED driver unloaded\n");
 }
@@ -287,4 +521,11 @@ MODULE_VERSION("2025-09-08_V1.1");
  * describe: 初始创建.
  * Revision 1.1, 2025-09-08, lium
  * describe: 使用 GPIO_TypeDef 结构体统一映射，优化代码结构。
+ * Revision 1.2, 2026-10-16, lium
+ * describe: 同时映射 GPIOC/GPIOE，新增 LED_IOCTL_SET_BATCH，按 bank 一次写入 GPIOXOUT.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 新增 mmap，寄存器页映射到用户空间；LED_IOCTL_GET_MAP_INFO 查询映射位置.
+ * Revision 1.4, 2026-10-17, lium
+ * describe: 写路径上的 printk 改为 led06_write 跟踪点与 pr_debug，
+ *           增加 debugfs 计数器 /sys/kernel/debug/led06/stats.
  *************************************************************************/
\ No newline at end of file
@@ -0,0 +1,302 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: executor_inl.h
+ *   软件模块: 任务执行线程池
+ *   功    能: 调度器线程只负责出堆和重新调度，到期回调交给若干工作线程执行，
+ *             一个回调阻塞(如读 DHT11 要 20ms 以上)不会推迟其他定时任务。
+ *             1. 每个工作线程有一个本地队列，本线程后进先出地取，空闲线程
+ *                从其他线程队列的另一端窃取(work stealing)；
+ *             2. serial_key 非 0 的任务固定派发到 serial_key % 线程数 的工作线程的
+ *                串行队列，不可窃取，相同键的任务按到期顺序依次执行，互不重叠；
+ *             3. 工作线程可按序号绑定到各个 CPU 核上(S5P6818 为 8 核)。
+ *             注意：包含本文件之后，回调在工作线程中执行，回调之间共享的数据需自行加锁。
+ *
+ ************************************************************************/
+#ifndef EXECUTOR_INL_H_
+#define EXECUTOR_INL_H_
+
+/* CPU_SET/pthread_setaffinity_np 需要 _GNU_SOURCE，且要在所有系统头文件之前定义，
+ * 定义得太晚时 CPU_SET 不可用，工作线程不绑核，其余功能不受影响。
+ */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include "sched_inl.h"
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__GNUC__)
+# define EXECUTOR_EXPORT(declaration) __attribute__((unused)) static declaration
+#else
+# define EXECUTOR_EXPORT(declaration) static declaration
+#endif
+
+#define EXECUTOR_MAX_WORKERS    8       /**最多的工作线程数 */
+#define EXECUTOR_MIN_WORKERS    4       /**默认线程数的下限，回调多是阻塞 I/O，单核上也需要多个线程 */
+#define EXECUTOR_QUEUE_SIZE     64      /**每个队列的容量，须为 2 的幂；进行中的任务不会重复派发，
+                                         * 所以只要任务总数不超过它就不会满 */
+
+/**以设备 fd 作为串行键，共用同一个 fd 的任务依次执行 */
+#define EXECUTOR_SERIAL_FD(fd)  ((unsigned int)(fd) + 1)
+
+/**环形队列，head 端先进先出(窃取/串行)，tail 端后进先出(本线程) */
+typedef struct TExecQueue_t {
+    TTaskControlBlock_t *items[EXECUTOR_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int tail;
+} TExecQueue_t;
+
+struct TExecutor_t;
+
+typedef struct TExecWorker_t {
+    struct TExecutor_t *exec;
+    pthread_t thread;
+    pthread_mutex_t lock;               /**保护 local/serial 两个队列 */
+    TExecQueue_t local;                 /**可被其他线程窃取的任务 */
+    TExecQueue_t serial;                /**绑定到本线程的串行任务，不可窃取 */
+    int serial_pending;                 /**serial 中的任务数，由 TExecutor_t::lock 保护 */
+    int index;
+    int cpu;                            /**绑定的 CPU，-1 表示不绑定 */
+} TExecWorker_t;
+
+typedef struct TExecutor_t {
+    TExecWorker_t workers[EXECUTOR_MAX_WORKERS];
+    int nworkers;
+    unsigned int next;                  /**轮流选择接收可窃取任务的工作线程，只在调度器线程中访问 */
+    pthread_mutex_t lock;               /**保护下面的计数及工作线程的休眠/唤醒 */
+    pthread_cond_t cond;
+    int stealable;                      /**所有 local 队列中的任务数 */
+    int running;
+    unsigned long long rejected;        /**队列已满、退回调度器线程就地执行的次数 */
+} TExecutor_t;
+
+static int executor_queue_push(TExecQueue_t *queue, TTaskControlBlock_t *task) {
+    if (queue->tail - queue->head == EXECUTOR_QUEUE_SIZE)
+        return -1;
+    queue->items[queue->tail & (EXECUTOR_QUEUE_SIZE - 1)] = task;
+    queue->tail += 1;
+    return 0;
+}
+
+static TTaskControlBlock_t *executor_queue_pop_head(TExecQueue_t *queue) {
+    TTaskControlBlock_t *task;
+
+    if (queue->head == queue->tail)
+        return NULL;
+    task = queue->items[queue->head & (EXECUTOR_QUEUE_SIZE - 1)];
+    queue->head += 1;
+    return task;
+}
+
+static TTaskControlBlock_t *executor_queue_pop_tail(TExecQueue_t *queue) {
+    if (queue->head == queue->tail)
+        return NULL;
+    queue->tail -= 1;
+    return queue->items[queue->tail & (EXECUTOR_QUEUE_SIZE - 1)];
+}
+
+/**
+ * @brief 按 串行队列 -> 本地队列 -> 窃取其他线程 的顺序取一个任务
+ * @return 没有可执行的任务返回 NULL
+ */
+static TTaskControlBlock_t *executor_take(TExecWorker_t *worker) {
+    TExecutor_t *exec = worker->exec;
+    TExecWorker_t *victim;
+    TTaskControlBlock_t *task;
+    int *counter = NULL;
+    int i;
+
+    pthread_mutex_lock(&worker->lock);
+    task = executor_queue_pop_head(&worker->serial);
+    if (task != NULL) {
+        counter = &worker->serial_pending;
+    } else {
+        task = executor_queue_pop_tail(&worker->local);
+        if (task != NULL)
+            counter = &exec->stealable;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    for (i = 1; task == NULL && i < exec->nworkers; i++) {
+        victim = &exec->workers[(worker->index + i) % exec->nworkers];
+        pthread_mutex_lock(&victim->lock);
+        task = executor_queue_pop_head(&victim->local);
+        pthread_mutex_unlock(&victim->lock);
+        if (task != NULL)
+            counter = &exec->stealable;
+    }
+
+    if (task != NULL) {
+        pthread_mutex_lock(&exec->lock);
+        *counter -= 1;
+        pthread_mutex_unlock(&exec->lock);
+    }
+    return task;
+}
+
+static void executor_pin(TExecWorker_t *worker) {
+#if defined(CPU_SET)
+    cpu_set_t set;
+
+    if (worker->cpu < 0)
+        return;
+    CPU_ZERO(&set);
+    CPU_SET(worker->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)worker;
+#endif
+}
+
+static void *executor_worker_main(void *arg) {
+    TExecWorker_t *worker = (TExecWorker_t *)arg;
+    TExecutor_t *exec = worker->exec;
+    TTaskControlBlock_t *task;
+    int running;
+
+    executor_pin(worker);
+
+    for (;;) {
+        task = executor_take(worker);
+        if (task != NULL) {
+            sched_task_execute(task);
+            continue;
+        }
+
+        pthread_mutex_lock(&exec->lock);
+        while (exec->running && exec->stealable <= 0 && worker->serial_pending <= 0)
+            pthread_cond_wait(&exec->cond, &exec->lock);
+        running = exec->running;
+        pthread_mutex_unlock(&exec->lock);
+
+        if (!running)
+            break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 派发函数，由调度器线程调用，见 sched_set_dispatch()
+ */
+static int executor_dispatch(void *arg, TTaskControlBlock_t *task) {
+    TExecutor_t *exec = (TExecutor_t *)arg;
+    TExecWorker_t *worker;
+    int serial = (task->serial_key != 0);
+    int ret;
+
+    if (serial)
+        worker = &exec->workers[task->serial_key % exec->nworkers];
+    else
+        worker = &exec->workers[exec->next++ % exec->nworkers];
+
+    pthread_mutex_lock(&worker->lock);
+    ret = executor_queue_push(serial ? &worker->serial : &worker->local, task);
+    pthread_mutex_unlock(&worker->lock);
+    if (ret != 0) {
+        exec->rejected += 1;
+        return -1;
+    }
+
+    pthread_mutex_lock(&exec->lock);
+    if (serial) {
+        worker->serial_pending += 1;
+        pthread_cond_broadcast(&exec->cond);    // 只有指定的线程能执行，全部唤醒
+    } else {
+        exec->stealable += 1;
+        pthread_cond_signal(&exec->cond);       // 任意一个线程都能取走
+    }
+    pthread_mutex_unlock(&exec->lock);
+    return 0;
+}
+
+EXECUTOR_EXPORT(void executor_destroy(TExecutor_t *exec));
+
+/**
+ * @brief 创建工作线程
+ * @param nworkers 线程数，<= 0 表示与在线 CPU 数相同(至少 EXECUTOR_MIN_WORKERS)，最多 EXECUTOR_MAX_WORKERS
+ * @param pin      非 0 时第 i 个线程绑定到第 i % CPU数 个核上
+ * @return 成功返回 0，失败返回 -1
+ */
+EXECUTOR_EXPORT(int executor_init(TExecutor_t *exec, int nworkers, int pin)) {
+    sigset_t all;
+    sigset_t old;
+    long ncpu;
+    int i;
+
+    memset(exec, 0, sizeof(*exec));
+
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1)
+        ncpu = 1;
+    if (nworkers <= 0)
+        nworkers = (ncpu > EXECUTOR_MIN_WORKERS) ? (int)ncpu : EXECUTOR_MIN_WORKERS;
+    if (nworkers > EXECUTOR_MAX_WORKERS)
+        nworkers = EXECUTOR_MAX_WORKERS;
+
+    pthread_mutex_init(&exec->lock, NULL);
+    pthread_cond_init(&exec->cond, NULL);
+    exec->running = 1;
+
+    // 工作线程屏蔽所有信号，信号(如 SIGUSR1 统计)只由事件循环线程处理
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    for (i = 0; i < nworkers; i++) {
+        TExecWorker_t *worker = &exec->workers[i];
+
+        worker->exec = exec;
+        worker->index = i;
+        worker->cpu = pin ? (int)(i % ncpu) : -1;
+        pthread_mutex_init(&worker->lock, NULL);
+        if (pthread_create(&worker->thread, NULL, executor_worker_main, worker) != 0) {
+            pthread_mutex_destroy(&worker->lock);
+            break;
+        }
+        exec->nworkers = i + 1;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (exec->nworkers != nworkers) {
+        executor_destroy(exec);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 让调度器把到期回调派发到线程池
+ */
+EXECUTOR_EXPORT(void executor_attach(TExecutor_t *exec, TScheduler_t *sched)) {
+    sched_set_dispatch(sched, executor_dispatch, exec);
+}
+
+/**
+ * @brief 停止并回收工作线程，正在执行的回调会执行完，队列中未执行的任务被丢弃
+ *        调用前应先停止事件循环，并用 sched_set_dispatch(sched, NULL, NULL) 解除派发。
+ */
+EXECUTOR_EXPORT(void executor_destroy(TExecutor_t *exec)) {
+    int i;
+
+    pthread_mutex_lock(&exec->lock);
+    exec->running = 0;
+    pthread_cond_broadcast(&exec->cond);
+    pthread_mutex_unlock(&exec->lock);
+
+    for (i = 0; i < exec->nworkers; i++) {
+        pthread_join(exec->workers[i].thread, NULL);
+        pthread_mutex_destroy(&exec->workers[i].lock);
+    }
+    exec->nworkers = 0;
+
+    pthread_cond_destroy(&exec->cond);
+    pthread_mutex_destroy(&exec->lock);
+}
+
+#undef EXECUTOR_EXPORT
+
+#endif  /* EXECUTOR_INL_H_ */
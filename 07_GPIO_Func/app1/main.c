@@ -9,9 +9,12 @@
  *   作    者: lium
  *   功    能:  任务A：在 t=0, 2s, 4s, 6s... 执行 → 开灯
  *              任务B：在 t=1s, 3s, 5s, 7s... 执行 → 关灯
- *              每秒闪烁一次，且完全不用 sleep，靠主循环轮询当前时间触发任务。
+ *              每个任务用一次 LED_IOCTL_SET_BATCH 同时设置 4 盏灯。
+ *              每秒闪烁一次，主循环阻塞在 epoll 上，由 timerfd 在任务到期时唤醒。
+ *              到期回调交给 executor_inl.h 线程池执行，LED 任务共用一个 fd，串行执行。
  ************************************************************************/
-#include "heap_inl.h"
+#include "executor_inl.h"      // 须在系统头文件之前，见其中 _GNU_SOURCE 的说明
+#include "event_loop_inl.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -21,133 +24,42 @@
 #include <time.h>
 #include <stdint.h>
 
-#define LED_DEVICE "/dev/LED4"
-
-// 全局文件描述符
-static int g_led_fd = -1;
-
-// container_of 宏
-#ifndef container_of
-# define container_of(ptr, type, member) \
-    ((type*)((char*)(ptr) - (size_t)&((type*)0)->member))
-#endif
-
-/**任务结构体 */
-typedef struct TTaskControlBlock_t {
-    struct heap_node node;
-    unsigned int expire_time;    /**初始时执行任务的时刻 */
-    unsigned int interval;       /**下一次执行任务的时刻 */
-    char name[32];               /**执行任务的名称 */     
-    void (*callback)(struct TTaskControlBlock_t*);
-} TTaskControlBlock_t;
-
-// 堆比较函数
-int timer_less_than(const struct heap_node *a, const struct heap_node *b) {
-    const TTaskControlBlock_t *ta = container_of(a, TTaskControlBlock_t, node);
-    const TTaskControlBlock_t *tb = container_of(b, TTaskControlBlock_t, node);
-    return ta->expire_time < tb->expire_time;
-}
-
-// 获取当前时间（毫秒）
-unsigned int get_current_time_ms(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (unsigned int)(ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL);
-}
-
-// 重新调度周期性任务
-void reschedule_timer(struct heap *heap, TTaskControlBlock_t *timer, unsigned int current_time) {
-    heap_remove(heap, &timer->node, timer_less_than);
-    timer->expire_time = current_time + timer->interval;
-    heap_insert(heap, &timer->node, timer_less_than);
-}
+#include <sys/ioctl.h>
 
-// --- 回调函数 ---
-void task_led0_on(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "00"; // 第0盏：状态为0
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [ON]");
-        fprintf(stderr, "Failed to turn on LED\n");
-    } else {
-        printf("[ON]  LED turned ON at %d ms\n", get_current_time_ms());
-    }
-}
+#define LED_DEVICE "/dev/LED4"
 
-void task_led0_off(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "01";  // 第0盏：状态为1
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [OFF]");
-        fprintf(stderr, "Failed to turn off LED\n");
-    } else {
-        printf("[OFF] LED turned OFF at %d ms\n", get_current_time_ms());
-    }
-}
+#define LED_NUM         4
+#define LED_MASK_ALL    ((1U << LED_NUM) - 1)
 
-void task_led1_on(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "10";     // 第1盏：状态为0
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [ON]");
-        fprintf(stderr, "Failed to turn on LED\n");
-    } else {
-        printf("[ON]  LED turned ON at %d ms\n", get_current_time_ms());
-    }
-}
+/**与驱动中的定义一致：mask 的第 i 位为 1 表示设置第 i 盏灯，value 的第 i 位为电平(0 亮 1 灭) */
+struct led_batch {
+    unsigned int mask;
+    unsigned int value;
+};
 
-void task_led1_off(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "11";     // 第1盏：状态为1
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [OFF]");
-        fprintf(stderr, "Failed to turn off LED\n");
-    } else {
-        printf("[OFF] LED turned OFF at %d ms\n", get_current_time_ms());
-    }
-}
+#define LED_MAGIC           'L'
+#define LED_IOCTL_SET_BATCH _IOW(LED_MAGIC, 0, struct led_batch)
+#define LED_IOCTL_GET_STATE _IOR(LED_MAGIC, 1, unsigned int)
 
-void task_led2_on(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "20";     // 第2盏：状态为0
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [ON]");
-        fprintf(stderr, "Failed to turn on LED\n");
-    } else {
-        printf("[ON]  LED turned ON at %d ms\n", get_current_time_ms());
-    }
-}
+// 全局文件描述符
+static int g_led_fd = -1;
 
-void task_led2_off(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "21";     // 第2盏：状态为1
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [OFF]");
-        fprintf(stderr, "Failed to turn off LED\n");
-    } else {
-        printf("[OFF] LED turned OFF at %d ms\n", get_current_time_ms());
-    }
-}
+/**一个闪烁相位：到期时按 batch 一次设置所有灯 */
+typedef struct TLedPhase_t {
+    TTaskControlBlock_t task;
+    struct led_batch batch;
+} TLedPhase_t;
 
-void task_led3_on(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "30";     // 第3盏：状态为0
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [ON]");
-        fprintf(stderr, "Failed to turn on LED\n");
-    } else {
-        printf("[ON]  LED turned ON at %d ms\n", get_current_time_ms());
-    }
-}
+// --- 回调函数 ---
+void task_led_phase(TTaskControlBlock_t *t) {
+    TLedPhase_t *phase = container_of(t, TLedPhase_t, task);
 
-void task_led3_off(TTaskControlBlock_t *t) {
-    unsigned char buf[] = "31";     // 第3盏：状态为1
-    ssize_t ret = write(g_led_fd, &buf, 2);
-    if (ret < 0) {
-        perror("write [OFF]");
-        fprintf(stderr, "Failed to turn off LED\n");
+    if (ioctl(g_led_fd, LED_IOCTL_SET_BATCH, &phase->batch) < 0) {
+        perror("ioctl [LED_IOCTL_SET_BATCH]");
+        fprintf(stderr, "[%s] Failed to set LEDs\n", t->name);
     } else {
-        printf("[OFF] LED turned OFF at %d ms\n", get_current_time_ms());
+        printf("[%s] LEDs 0x%x -> 0x%x at %d ms\n", t->name,
+               phase->batch.mask, phase->batch.value, get_current_time_ms());
     }
 }
 
@@ -162,84 +74,65 @@ int main() {
     printf("Application: opened %s successfully\n", LED_DEVICE);
 
     // 2. 初始化任务调度器
-    struct heap timer_heap;
-    heap_init(&timer_heap);
-
-    // 3. 创建Led0任务
-    TTaskControlBlock_t task_on = {0};
-    task_on.expire_time = get_current_time_ms();
-    task_on.interval     = 2000;
-    strcpy(task_on.name, "LED0_ON");
-    task_on.callback     = task_led0_on;  // 类型匹配
-    TTaskControlBlock_t task_off = {0};
-    task_off.expire_time = get_current_time_ms() + 1000;
-    task_off.interval    = 2000;
-    strcpy(task_off.name, "LED0_OFF");
-    task_off.callback    = task_led0_off;  // 类型匹配
-
-    /**任务2 */
-    TTaskControlBlock_t task2_on = {0};
-    task2_on.expire_time = get_current_time_ms();
-    task2_on.interval     = 2000;
-    strcpy(task2_on.name, "LED1_ON");
-    task2_on.callback     = task_led1_on;  // 类型匹配
-    TTaskControlBlock_t task2_off = {0};
-    task2_off.expire_time = get_current_time_ms() + 1000;
-    task2_off.interval    = 2000;
-    strcpy(task2_off.name, "LED1_OFF");
-    task2_off.callback    = task_led1_off;  // 类型匹配
-
-    /**任务3 */
-    TTaskControlBlock_t task3_on = {0};
-    task3_on.expire_time = get_current_time_ms();
-    task3_on.interval     = 1000;
-    strcpy(task3_on.name, "LED2_ON");
-    task3_on.callback     = task_led2_on;  // 类型匹配
-    TTaskControlBlock_t task3_off = {0};
-    task3_off.expire_time = get_current_time_ms() + 1000;
-    task3_off.interval    = 1000;
-    strcpy(task3_off.name, "LED2_OFF");
-    task3_off.callback    = task_led2_off;  // 类型匹配
-
-    /**任务4 */
-    TTaskControlBlock_t task4_on = {0};
-    task4_on.expire_time = get_current_time_ms();
-    task4_on.interval     = 1000;
-    strcpy(task4_on.name, "LED3_ON");
-    task4_on.callback     = task_led3_on;  // 类型匹配
-    TTaskControlBlock_t task4_off = {0};
-    task4_off.expire_time = get_current_time_ms() + 1000;
-    task4_off.interval    = 1000;
-    strcpy(task4_off.name, "LED3_OFF");
-    task4_off.callback    = task_led3_off;  // 类型匹配
+    TScheduler_t sched;
+    unsigned long long now = get_current_time_ns();     // 所有任务以同一时刻为相位基准
+    sched_init(&sched, now);
+
+    // 打开任务统计：kill -USR1 <pid> 输出迟到时间和回调耗时，设置环境变量 SCHED_STATS_FILE 则追加写入该文件
+    sched_enable_stats(&sched);
+
+    // 3. 创建两个相位任务：偶数秒全部点亮，奇数秒全部熄灭
+    TLedPhase_t phase_on;
+    memset(&phase_on, 0, sizeof(phase_on));
+    phase_on.task.expire_time = now;
+    phase_on.task.interval    = SCHED_MS(2000);
+    strcpy(phase_on.task.name, "LED_ON");
+    phase_on.task.callback    = task_led_phase;
+    phase_on.batch.mask       = LED_MASK_ALL;
+    phase_on.batch.value      = 0;
+
+    TLedPhase_t phase_off;
+    memset(&phase_off, 0, sizeof(phase_off));
+    phase_off.task.expire_time = now + SCHED_MS(1000);
+    phase_off.task.interval    = SCHED_MS(2000);
+    strcpy(phase_off.task.name, "LED_OFF");
+    phase_off.task.callback    = task_led_phase;
+    phase_off.batch.mask       = LED_MASK_ALL;
+    phase_off.batch.value      = LED_MASK_ALL;
+
+    // 4. 回调交给线程池执行；两个任务都写 g_led_fd，使用同一个串行键，按到期顺序依次执行
+    TExecutor_t executor;
+    if (executor_init(&executor, 0, 1) < 0) {
+        perror("executor_init");
+        close(g_led_fd);
+        return EXIT_FAILURE;
+    }
+    executor_attach(&executor, &sched);
+
+    phase_on.task.serial_key  = EXECUTOR_SERIAL_FD(g_led_fd);
+    phase_off.task.serial_key = EXECUTOR_SERIAL_FD(g_led_fd);
 
     // 5. 插入任务
-    heap_insert(&timer_heap, &task_on.node, timer_less_than);
-    heap_insert(&timer_heap, &task_off.node, timer_less_than);
-    heap_insert(&timer_heap, &task2_on.node, timer_less_than);
-    heap_insert(&timer_heap, &task2_off.node, timer_less_than);
-    heap_insert(&timer_heap, &task3_on.node, timer_less_than);
-    heap_insert(&timer_heap, &task3_off.node, timer_less_than);
-    heap_insert(&timer_heap, &task4_on.node, timer_less_than);
-    heap_insert(&timer_heap, &task4_off.node, timer_less_than);
+    sched_add_task(&sched, &phase_on.task);
+    sched_add_task(&sched, &phase_off.task);
 
     printf("LED blinking started (1Hz). Press Ctrl+C to stop.\n");
 
-    // 6. 主循环
-    while (1) {
-        unsigned int current_time = get_current_time_ms();
-
-        while (heap_min(&timer_heap) != NULL) {
-            TTaskControlBlock_t *timer = container_of(heap_min(&timer_heap), TTaskControlBlock_t, node);
-            if (timer->expire_time <= current_time) {
-                timer->callback(timer);  
-                reschedule_timer(&timer_heap, timer, current_time);
-            } else {
-                break;
-            }
-        }
+    // 6. 主循环：阻塞到下一个任务到期，空闲时不占用 CPU
+    TEventLoop_t loop;
+    if (event_loop_init(&loop, &sched) < 0) {
+        perror("event_loop_init");
+        executor_destroy(&executor);
+        close(g_led_fd);
+        return EXIT_FAILURE;
     }
+    if (event_loop_dump_stats_on_signal(&loop, SIGUSR1, getenv("SCHED_STATS_FILE")) < 0)
+        perror("event_loop_dump_stats_on_signal");
+    event_loop_run(&loop);
+    event_loop_close(&loop);
 
+    sched_set_dispatch(&sched, NULL, NULL);
+    executor_destroy(&executor);
     close(g_led_fd);
     return 0;
 }
@@ -247,4 +140,16 @@ int main() {
  * 改动历史纪录：
  * Revision 1.0, 2025-08-31, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-16, lium
+ * describe: 任务调度移入 sched_inl.h，可编译选择最小堆或分层时间轮.
+ * Revision 1.2, 2026-10-16, lium
+ * describe: 主循环改为 event_loop_inl.h，阻塞等待下一个到期时刻，不再忙等.
+ * Revision 1.3, 2026-10-16, lium
+ * describe: 时间改用 64 位纳秒，周期任务按 expire += interval 推进，不再累积漂移.
+ * Revision 1.4, 2026-10-16, lium
+ * describe: 打开任务统计，收到 SIGUSR1 时输出迟到时间和回调耗时直方图.
+ * Revision 1.5, 2026-10-16, lium
+ * describe: 回调派发到 executor_inl.h 工作线程池，LED 任务按设备 fd 串行执行.
+ * Revision 1.6, 2026-10-16, lium
+ * describe: 8 个单灯任务合并为开/关两个相位任务，每个相位一次 ioctl 设置 4 盏灯.
  *************************************************************************/
\ No newline at end of file
@@ -0,0 +1,348 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: sched_inl.h
+ *   软件模块: 周期任务调度器
+ *   功    能: 封装任务结构体 TTaskControlBlock_t 及其调度，底层定时器容器
+ *             在编译时选择：
+ *             默认                    最小堆(heap_inl.h)，O(log n)
+ *             -DSCHED_USE_TIMER_WHEEL 分层时间轮(timer_wheel_inl.h)，O(1)
+ *             也可以在包含本文件之前 #define SCHED_USE_TIMER_WHEEL。
+ *             时间统一使用 64 位 CLOCK_MONOTONIC 纳秒，设备连续运行数月也不会回绕。
+ *             调用 sched_enable_stats() 后，每个任务都会记录迟到时间/耗时直方图。
+ *             默认回调在调用 sched_run_pending 的线程中就地执行；调用
+ *             sched_set_dispatch() 后到期回调交给派发函数(如 executor_inl.h
+ *             线程池)执行，调度器线程只负责出堆和重新调度。
+ *
+ ************************************************************************/
+#ifndef SCHED_INL_H_
+#define SCHED_INL_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include "sched_stats_inl.h"
+
+#if defined(SCHED_USE_TIMER_WHEEL)
+# include "timer_wheel_inl.h"
+#else
+# include "heap_inl.h"
+#endif
+
+#if defined(__GNUC__)
+# define SCHED_EXPORT(declaration) __attribute__((unused)) static declaration
+#else
+# define SCHED_EXPORT(declaration) static declaration
+#endif
+
+// container_of 宏
+#ifndef container_of
+# define container_of(ptr, type, member) \
+    ((type*)((char*)(ptr) - (size_t)&((type*)0)->member))
+#endif
+
+/**时间换算，调度器内部的时间单位为纳秒 */
+#define SCHED_NSEC_PER_USEC     1000ULL
+#define SCHED_NSEC_PER_MSEC     1000000ULL
+#define SCHED_NSEC_PER_SEC      1000000000ULL
+#define SCHED_MS(ms)            ((unsigned long long)(ms) * SCHED_NSEC_PER_MSEC)
+
+/**时间轮 1 个 tick 的长度(ns)，到期时刻向上取整到 tick，保证不会提前执行 */
+#ifndef SCHED_WHEEL_TICK_NS
+# define SCHED_WHEEL_TICK_NS    SCHED_NSEC_PER_MSEC
+#endif
+
+/**周期任务执行后如何计算下一次到期时刻 */
+typedef enum {
+    SCHED_POLICY_SKIP = 0,       /**expire += interval 保持相位，错过的周期直接跳过(默认) */
+    SCHED_POLICY_CATCH_UP,       /**expire += interval 保持相位，错过几个周期就连续补执行几次 */
+    SCHED_POLICY_RELATIVE        /**expire = 本次执行时刻 + interval，每次延迟都会累积成相位漂移 */
+} TSchedPolicy_t;
+
+/**任务结构体 */
+typedef struct TTaskControlBlock_t {
+#if defined(SCHED_USE_TIMER_WHEEL)
+    struct timer_wheel_node node;
+#else
+    struct heap_node node;
+#endif
+    unsigned long long expire_time;  /**下一次执行任务的时刻(ns) */
+    unsigned long long interval;     /**执行任务的周期(ns)，为 0 表示只执行一次 */
+    TSchedPolicy_t policy;           /**重新调度策略 */
+    unsigned int missed;             /**SKIP 策略下累计跳过的周期数 */
+    char name[32];                   /**执行任务的名称 */
+    void (*callback)(struct TTaskControlBlock_t*);
+    TSchedStats_t *stats;            /**执行统计，NULL 表示不统计 */
+    unsigned int serial_key;         /**串行键，非 0 时相同键的任务按到期顺序依次执行，如共用一个设备 fd 的任务 */
+    volatile int in_flight;          /**回调已派发但尚未执行完 */
+    unsigned long long run_expire;   /**本次执行对应的到期时刻(ns) */
+    unsigned long long run_next;     /**本次执行之后的下一次到期时刻(ns)，一次性任务为 0 */
+} TTaskControlBlock_t;
+
+/**
+ * 派发函数：把到期任务交给其他线程执行，执行时调用 sched_task_execute()
+ * @return 接收返回 0；返回非 0 时调度器就地执行该任务
+ */
+typedef int (*sched_dispatch_fn)(void *arg, TTaskControlBlock_t *task);
+
+/**调度器 */
+typedef struct TScheduler_t {
+#if defined(SCHED_USE_TIMER_WHEEL)
+    struct timer_wheel wheel;    /**时间轮，1 tick = SCHED_WHEEL_TICK_NS */
+#else
+    struct heap heap;            /**按 expire_time 排序的最小堆 */
+#endif
+    int stats_enabled;           /**非 0 时 sched_add_task 为任务分配统计 */
+    TSchedStats_t *stats_head;   /**所有任务统计组成的链表，用于输出 */
+    sched_dispatch_fn dispatch;  /**NULL 表示就地执行回调 */
+    void *dispatch_arg;
+} TScheduler_t;
+
+// 获取当前时间（纳秒）
+SCHED_EXPORT(unsigned long long get_current_time_ns(void)) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * SCHED_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// 获取当前时间（毫秒），32 位会回绕，仅用于打印日志
+SCHED_EXPORT(unsigned int get_current_time_ms(void)) {
+    return (unsigned int)(get_current_time_ns() / SCHED_NSEC_PER_MSEC);
+}
+
+#if defined(SCHED_USE_TIMER_WHEEL)
+static unsigned long long sched_ns_to_tick(unsigned long long ns) {
+    return (ns + SCHED_WHEEL_TICK_NS - 1) / SCHED_WHEEL_TICK_NS;
+}
+#else
+// 堆比较函数
+static int timer_less_than(const struct heap_node *a, const struct heap_node *b) {
+    const TTaskControlBlock_t *ta = container_of(a, TTaskControlBlock_t, node);
+    const TTaskControlBlock_t *tb = container_of(b, TTaskControlBlock_t, node);
+    return ta->expire_time < tb->expire_time;
+}
+#endif
+
+/**
+ * @brief 初始化调度器
+ * @param now 当前时刻(ns)
+ */
+SCHED_EXPORT(void sched_init(TScheduler_t *sched, unsigned long long now)) {
+    sched->stats_enabled = 0;
+    sched->stats_head = NULL;
+    sched->dispatch = NULL;
+    sched->dispatch_arg = NULL;
+#if defined(SCHED_USE_TIMER_WHEEL)
+    timer_wheel_init(&sched->wheel, now / SCHED_WHEEL_TICK_NS);
+#else
+    (void)now;
+    heap_init(&sched->heap);
+#endif
+}
+
+/**
+ * @brief 打开任务统计，对之后添加的任务生效
+ */
+SCHED_EXPORT(void sched_enable_stats(TScheduler_t *sched)) {
+    sched->stats_enabled = 1;
+}
+
+/**
+ * @brief 设置派发函数，dispatch 为 NULL 时恢复就地执行
+ */
+SCHED_EXPORT(void sched_set_dispatch(TScheduler_t *sched, sched_dispatch_fn dispatch, void *arg)) {
+    sched->dispatch = dispatch;
+    sched->dispatch_arg = arg;
+}
+
+/**
+ * @brief 输出所有任务的统计
+ * @param path 追加写入的文件，NULL 表示输出到 stderr
+ */
+SCHED_EXPORT(int sched_dump_stats(const TScheduler_t *sched, const char *path)) {
+    FILE *fp = stderr;
+
+    if (path != NULL) {
+        fp = fopen(path, "a");
+        if (fp == NULL)
+            return -1;
+    }
+    sched_stats_print(fp, sched->stats_head);
+    if (fp != stderr)
+        fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief 添加任务，任务在 task->expire_time 时刻首次执行
+ */
+SCHED_EXPORT(void sched_add_task(TScheduler_t *sched, TTaskControlBlock_t *task)) {
+    if (sched->stats_enabled && task->stats == NULL) {
+        task->stats = sched_stats_new(task->name);
+        if (task->stats != NULL) {
+            task->stats->next = sched->stats_head;
+            sched->stats_head = task->stats;
+        }
+    }
+
+#if defined(SCHED_USE_TIMER_WHEEL)
+    timer_wheel_insert(&sched->wheel, &task->node, sched_ns_to_tick(task->expire_time));
+#else
+    heap_insert(&sched->heap, &task->node, timer_less_than);
+#endif
+}
+
+/**
+ * @brief 删除任务
+ */
+SCHED_EXPORT(void sched_remove_task(TScheduler_t *sched, TTaskControlBlock_t *task)) {
+#if defined(SCHED_USE_TIMER_WHEEL)
+    timer_wheel_remove(&sched->wheel, &task->node);
+#else
+    heap_remove(&sched->heap, &task->node, timer_less_than);
+#endif
+}
+
+/**
+ * @brief 查询最早到期任务的时刻
+ * @param expire 输出最早的到期时刻(ns)；时间轮可能给出更早的下移时刻，提前醒来无副作用
+ * @return 没有任务返回 -1，否则返回 0
+ */
+SCHED_EXPORT(int sched_next_expire(const TScheduler_t *sched, unsigned long long *expire)) {
+#if defined(SCHED_USE_TIMER_WHEEL)
+    unsigned long long tick;
+
+    if (timer_wheel_next_expire(&sched->wheel, &tick) != 0)
+        return -1;
+    *expire = tick * SCHED_WHEEL_TICK_NS;
+    return 0;
+#else
+    if (heap_min(&sched->heap) == NULL)
+        return -1;
+    *expire = container_of(heap_min(&sched->heap), TTaskControlBlock_t, node)->expire_time;
+    return 0;
+#endif
+}
+
+/**
+ * @brief 取出一个已经到期的任务，取出后任务不在调度器中
+ * @return 没有到期任务返回 NULL
+ */
+static TTaskControlBlock_t *sched_pop_expired(TScheduler_t *sched, unsigned long long current_time) {
+#if defined(SCHED_USE_TIMER_WHEEL)
+    struct timer_wheel_node *node = timer_wheel_expired(&sched->wheel, current_time / SCHED_WHEEL_TICK_NS);
+    if (node == NULL)
+        return NULL;
+    return container_of(node, TTaskControlBlock_t, node);
+#else
+    TTaskControlBlock_t *task;
+
+    if (heap_min(&sched->heap) == NULL)
+        return NULL;
+    task = container_of(heap_min(&sched->heap), TTaskControlBlock_t, node);
+    if (task->expire_time > current_time)
+        return NULL;
+    heap_dequeue(&sched->heap, timer_less_than);
+    return task;
+#endif
+}
+
+/**
+ * @brief 按任务的策略计算下一次到期时刻
+ * @param current_time 本次执行时的当前时刻(ns)
+ * @return 周期任务返回 0，一次性任务返回 -1
+ */
+static int sched_advance(TTaskControlBlock_t *task, unsigned long long current_time) {
+    unsigned long long behind;
+
+    if (task->interval == 0)
+        return -1;
+
+    switch (task->policy) {
+        case SCHED_POLICY_RELATIVE:
+            task->expire_time = current_time + task->interval;
+            break;
+        case SCHED_POLICY_CATCH_UP:
+            task->expire_time += task->interval;
+            break;
+        case SCHED_POLICY_SKIP:
+        default:
+            task->expire_time += task->interval;
+            if (task->expire_time <= current_time) {
+                // 跳到 current_time 之后的第一个周期点，相位不变
+                behind = (current_time - task->expire_time) / task->interval + 1;
+                task->expire_time += behind * task->interval;
+                task->missed += (unsigned int)behind;
+            }
+            break;
+    }
+    return 0;
+}
+
+/**
+ * @brief 执行一次任务回调并记录统计，可以在任意线程中调用
+ *        调度器在调用前已经填好 run_expire/run_next 并重新调度了周期任务。
+ */
+SCHED_EXPORT(void sched_task_execute(TTaskControlBlock_t *task)) {
+    unsigned long long start = 0;
+    unsigned long long end;
+
+    if (task->stats != NULL)
+        start = get_current_time_ns();
+
+    task->callback(task);
+
+    if (task->stats != NULL) {
+        end = get_current_time_ns();
+        sched_stats_record(task->stats,
+                           start > task->run_expire ? start - task->run_expire : 0,
+                           end - start,
+                           task->run_next != 0 && end >= task->run_next);
+    }
+
+    // 最后才清除标志，之后调度器才会再次派发该任务
+    __sync_lock_release(&task->in_flight);
+}
+
+/**
+ * @brief 执行所有到期的任务，并按周期重新调度
+ *        设置了派发函数时只负责派发；上一次回调还没执行完的任务本周期不再派发，
+ *        记为一次 overrun。CATCH_UP 策略在这种情况下与 SKIP 相同。
+ * @param current_time 当前时刻(ns)
+ * @return 本次执行(或派发)的任务个数
+ */
+SCHED_EXPORT(int sched_run_pending(TScheduler_t *sched, unsigned long long current_time)) {
+    TTaskControlBlock_t *task;
+    int periodic;
+    int count = 0;
+
+    while ((task = sched_pop_expired(sched, current_time)) != NULL) {
+        if (task->in_flight) {
+            task->missed += 1;
+            if (task->stats != NULL)
+                sched_stats_record_overrun(task->stats);
+            if (sched_advance(task, current_time) == 0)
+                sched_add_task(sched, task);
+            continue;
+        }
+
+        // 先重新调度周期性任务，回调可能在其他线程中执行，不再访问调度器
+        task->run_expire = task->expire_time;
+        periodic = (sched_advance(task, current_time) == 0);
+        task->run_next = periodic ? task->expire_time : 0;
+        if (periodic)
+            sched_add_task(sched, task);
+        count++;
+
+        if (sched->dispatch != NULL) {
+            __sync_lock_test_and_set(&task->in_flight, 1);
+            if (sched->dispatch(sched->dispatch_arg, task) == 0)
+                continue;
+        }
+        sched_task_execute(task);
+    }
+    return count;
+}
+
+#undef SCHED_EXPORT
+
+#endif  /* SCHED_INL_H_ */
@@ -0,0 +1,168 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: sched_stats_inl.h
+ *   软件模块: 调度统计
+ *   功    能: 每个任务的执行统计：执行次数、超时(overrun)次数、迟到时间与
+ *             回调耗时的直方图。直方图按 2 的幂分段、每段再线性细分
+ *             (HDR 风格)，相对误差不超过 1/SCHED_HIST_SUB_BUCKETS；
+ *             记录时只做原子加，不加锁，可以在多个线程中同时记录。
+ *
+ ************************************************************************/
+#ifndef SCHED_STATS_INL_H_
+#define SCHED_STATS_INL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__)
+# define SCHED_STATS_EXPORT(declaration) __attribute__((unused)) static declaration
+#else
+# define SCHED_STATS_EXPORT(declaration) static declaration
+#endif
+
+#define SCHED_HIST_SUB_BITS      4                              /**每个 2 的幂区间细分为 16 个桶 */
+#define SCHED_HIST_SUB_BUCKETS   (1 << SCHED_HIST_SUB_BITS)
+#define SCHED_HIST_MAX_EXP       40                             /**最大约 2^41 ns(36 分钟)，更大的计入最后一个桶 */
+#define SCHED_HIST_BUCKETS       ((SCHED_HIST_MAX_EXP - SCHED_HIST_SUB_BITS + 2) * SCHED_HIST_SUB_BUCKETS)
+
+/**对数分桶直方图，单位 ns */
+typedef struct TSchedHist_t {
+    unsigned long long count;
+    unsigned long long max;
+    unsigned int buckets[SCHED_HIST_BUCKETS];
+} TSchedHist_t;
+
+/**单个任务的统计 */
+typedef struct TSchedStats_t {
+    struct TSchedStats_t *next;         /**调度器中的统计链表 */
+    const char *name;                   /**任务名，指向 TTaskControlBlock_t::name */
+    unsigned long long runs;            /**回调执行次数 */
+    unsigned long long overruns;        /**回调结束时已经过了下一次到期时刻，或因回调未结束而跳过的次数 */
+    TSchedHist_t lateness;              /**实际开始时刻 - 到期时刻 */
+    TSchedHist_t duration;              /**回调耗时 */
+} TSchedStats_t;
+
+static unsigned int sched_hist_index(unsigned long long value) {
+    unsigned int exp;
+
+    if (value < SCHED_HIST_SUB_BUCKETS)
+        return (unsigned int)value;
+
+    exp = 63 - __builtin_clzll(value);
+    if (exp > SCHED_HIST_MAX_EXP)
+        return SCHED_HIST_BUCKETS - 1;
+
+    return (exp - SCHED_HIST_SUB_BITS + 1) * SCHED_HIST_SUB_BUCKETS +
+           (unsigned int)((value >> (exp - SCHED_HIST_SUB_BITS)) & (SCHED_HIST_SUB_BUCKETS - 1));
+}
+
+/**桶内可能出现的最大值，报告百分位时取该值(偏保守) */
+static unsigned long long sched_hist_bucket_high(unsigned int index) {
+    unsigned int group = index / SCHED_HIST_SUB_BUCKETS;
+    unsigned int sub = index % SCHED_HIST_SUB_BUCKETS;
+
+    if (group == 0)
+        return index;
+    return ((unsigned long long)(SCHED_HIST_SUB_BUCKETS + sub + 1) << (group - 1)) - 1;
+}
+
+SCHED_STATS_EXPORT(void sched_hist_record(TSchedHist_t *hist, unsigned long long value)) {
+    unsigned long long max;
+
+    __sync_fetch_and_add(&hist->buckets[sched_hist_index(value)], 1);
+    __sync_fetch_and_add(&hist->count, 1);
+
+    max = hist->max;
+    while (value > max) {
+        if (__sync_bool_compare_and_swap(&hist->max, max, value))
+            break;
+        max = hist->max;
+    }
+}
+
+/**
+ * @brief 计算百分位
+ * @param permille 千分位，例如 500 = p50，999 = p99.9
+ */
+SCHED_STATS_EXPORT(unsigned long long sched_hist_percentile(const TSchedHist_t *hist, unsigned int permille)) {
+    unsigned long long target;
+    unsigned long long seen = 0;
+    unsigned long long high;
+    unsigned int i;
+
+    if (hist->count == 0)
+        return 0;
+
+    target = (hist->count * permille + 999) / 1000;
+    if (target == 0)
+        target = 1;
+
+    for (i = 0; i < SCHED_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            high = sched_hist_bucket_high(i);
+            return high < hist->max ? high : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+SCHED_STATS_EXPORT(TSchedStats_t *sched_stats_new(const char *name)) {
+    TSchedStats_t *stats = calloc(1, sizeof(*stats));
+    if (stats != NULL)
+        stats->name = name;
+    return stats;
+}
+
+/**
+ * @brief 记录一次执行
+ * @param lateness   开始执行时刻 - 到期时刻(ns)
+ * @param duration   回调耗时(ns)
+ * @param overrun    回调结束时是否已经错过了下一次到期时刻
+ */
+SCHED_STATS_EXPORT(void sched_stats_record(TSchedStats_t *stats,
+                                           unsigned long long lateness,
+                                           unsigned long long duration,
+                                           int overrun)) {
+    __sync_fetch_and_add(&stats->runs, 1);
+    if (overrun)
+        __sync_fetch_and_add(&stats->overruns, 1);
+    sched_hist_record(&stats->lateness, lateness);
+    sched_hist_record(&stats->duration, duration);
+}
+
+/**
+ * @brief 记录一次因上一次回调尚未结束而跳过的执行，只计入 overruns
+ */
+SCHED_STATS_EXPORT(void sched_stats_record_overrun(TSchedStats_t *stats)) {
+    __sync_fetch_and_add(&stats->overruns, 1);
+}
+
+static void sched_hist_print(FILE *fp, const char *label, const TSchedHist_t *hist) {
+    fprintf(fp, "    %-8s p50 %9.1f  p90 %9.1f  p99 %9.1f  p99.9 %9.1f  max %9.1f us\n",
+            label,
+            sched_hist_percentile(hist, 500) / 1000.0,
+            sched_hist_percentile(hist, 900) / 1000.0,
+            sched_hist_percentile(hist, 990) / 1000.0,
+            sched_hist_percentile(hist, 999) / 1000.0,
+            hist->max / 1000.0);
+}
+
+/**
+ * @brief 打印链表中所有任务的统计
+ */
+SCHED_STATS_EXPORT(void sched_stats_print(FILE *fp, const TSchedStats_t *head)) {
+    const TSchedStats_t *stats;
+
+    fprintf(fp, "==== scheduler stats ====\n");
+    for (stats = head; stats != NULL; stats = stats->next) {
+        fprintf(fp, "[%s] runs %llu  overruns %llu\n", stats->name, stats->runs, stats->overruns);
+        sched_hist_print(fp, "late", &stats->lateness);
+        sched_hist_print(fp, "duration", &stats->duration);
+    }
+    fflush(fp);
+}
+
+#undef SCHED_STATS_EXPORT
+
+#endif  /* SCHED_STATS_INL_H_ */
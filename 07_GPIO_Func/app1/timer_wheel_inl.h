@@ -0,0 +1,242 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: timer_wheel_inl.h
+ *   软件模块: 分层时间轮
+ *   功    能: 与 heap_inl.h 同为定时器容器，插入/删除/触发均为 O(1)。
+ *             共 TIMER_WHEEL_LEVELS 层，每层 64 个槽，单位为 tick：
+ *             第0层每槽 1 tick，第1层每槽 64 tick，依次类推，4 层可覆盖
+ *             2^24 tick；更远的定时器先挂在最高层，到期前再逐层下移(cascade)。
+ *
+ ************************************************************************/
+#ifndef TIMER_WHEEL_INL_H_
+#define TIMER_WHEEL_INL_H_
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+# define TIMER_WHEEL_EXPORT(declaration) __attribute__((unused)) static declaration
+#else
+# define TIMER_WHEEL_EXPORT(declaration) static declaration
+#endif
+
+#define TIMER_WHEEL_LEVELS      4
+#define TIMER_WHEEL_SLOT_BITS   6
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK   (TIMER_WHEEL_SLOTS - 1)
+
+/**时间轮能直接表示的最大相对时长(tick)，超出的先按该值挂入最高层 */
+#define TIMER_WHEEL_MAX_DELTA \
+    ((1ULL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+/**嵌入到任务结构体中的节点，槽内以双向循环链表组织 */
+struct timer_wheel_node {
+    struct timer_wheel_node *next;
+    struct timer_wheel_node *prev;
+    unsigned long long expire;          /**到期时刻(tick) */
+};
+
+struct timer_wheel {
+    unsigned long long now;             /**当前正在处理的 tick，之前的 tick 均已处理 */
+    unsigned int nelts;                 /**时间轮中的定时器个数 */
+    struct timer_wheel_node slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];   /**每个槽的链表头 */
+};
+
+/* Public functions. */
+TIMER_WHEEL_EXPORT(void timer_wheel_init(struct timer_wheel *wheel,
+                                         unsigned long long now));
+
+TIMER_WHEEL_EXPORT(void timer_wheel_insert(struct timer_wheel *wheel,
+                                           struct timer_wheel_node *node,
+                                           unsigned long long expire));
+
+TIMER_WHEEL_EXPORT(void timer_wheel_remove(struct timer_wheel *wheel,
+                                           struct timer_wheel_node *node));
+
+TIMER_WHEEL_EXPORT(struct timer_wheel_node *timer_wheel_expired(struct timer_wheel *wheel,
+                                                                unsigned long long now));
+
+TIMER_WHEEL_EXPORT(int timer_wheel_next_expire(const struct timer_wheel *wheel,
+                                               unsigned long long *expire));
+
+/* Implementation follows. */
+
+static void timer_wheel_list_add(struct timer_wheel_node *head,
+                                 struct timer_wheel_node *node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void timer_wheel_list_del(struct timer_wheel_node *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+TIMER_WHEEL_EXPORT(void timer_wheel_init(struct timer_wheel *wheel,
+                                         unsigned long long now)) {
+    int level;
+    int slot;
+
+    wheel->now = now;
+    wheel->nelts = 0;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            wheel->slots[level][slot].next = &wheel->slots[level][slot];
+            wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+        }
+    }
+}
+
+/**根据到期时刻与当前 tick 的距离选择层，再用到期时刻的对应位段选择槽 */
+static void timer_wheel_place(struct timer_wheel *wheel,
+                              struct timer_wheel_node *node) {
+    unsigned long long expire = node->expire;
+    unsigned long long delta;
+    unsigned int shift;
+    int level;
+
+    if (expire < wheel->now)
+        expire = wheel->now;
+    delta = expire - wheel->now;
+    if (delta > TIMER_WHEEL_MAX_DELTA) {
+        delta = TIMER_WHEEL_MAX_DELTA;
+        expire = wheel->now + delta;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < (1ULL << (TIMER_WHEEL_SLOT_BITS * (level + 1))))
+            break;
+    }
+
+    shift = TIMER_WHEEL_SLOT_BITS * level;
+    timer_wheel_list_add(&wheel->slots[level][(expire >> shift) & TIMER_WHEEL_SLOT_MASK], node);
+}
+
+TIMER_WHEEL_EXPORT(void timer_wheel_insert(struct timer_wheel *wheel,
+                                           struct timer_wheel_node *node,
+                                           unsigned long long expire)) {
+    node->expire = expire;
+    timer_wheel_place(wheel, node);
+    wheel->nelts += 1;
+}
+
+TIMER_WHEEL_EXPORT(void timer_wheel_remove(struct timer_wheel *wheel,
+                                           struct timer_wheel_node *node)) {
+    if (node->next == NULL)
+        return;
+    timer_wheel_list_del(node);
+    wheel->nelts -= 1;
+}
+
+/**第0层转完一圈时，把上层当前槽里的定时器重新放置到更低的层 */
+static void timer_wheel_cascade(struct timer_wheel *wheel) {
+    struct timer_wheel_node list;
+    struct timer_wheel_node *head;
+    struct timer_wheel_node *node;
+    unsigned int index;
+    int level;
+
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        index = (wheel->now >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+        head = &wheel->slots[level][index];
+
+        /* 先把整个槽摘下来，避免重新放置时又落回同一个槽 */
+        if (head->next != head) {
+            list.next = head->next;
+            list.prev = head->prev;
+            list.next->prev = &list;
+            list.prev->next = &list;
+            head->next = head;
+            head->prev = head;
+
+            while (list.next != &list) {
+                node = list.next;
+                timer_wheel_list_del(node);
+                timer_wheel_place(wheel, node);
+            }
+        }
+
+        if (index != 0)
+            break;
+    }
+}
+
+/**
+ * @brief 取出一个到期(expire <= now)的定时器，没有则返回 NULL
+ *        调用方循环调用直到返回 NULL；取出的节点已不在时间轮中。
+ */
+TIMER_WHEEL_EXPORT(struct timer_wheel_node *timer_wheel_expired(struct timer_wheel *wheel,
+                                                                unsigned long long now)) {
+    struct timer_wheel_node *head;
+    struct timer_wheel_node *node;
+
+    for (;;) {
+        head = &wheel->slots[0][wheel->now & TIMER_WHEEL_SLOT_MASK];
+        if (head->next != head) {
+            node = head->next;
+            timer_wheel_list_del(node);
+            wheel->nelts -= 1;
+            return node;
+        }
+
+        if (wheel->now >= now)
+            return NULL;
+
+        /* 时间轮为空，直接跳到目标 tick，省去逐槽推进 */
+        if (wheel->nelts == 0) {
+            wheel->now = now;
+            continue;
+        }
+
+        wheel->now += 1;
+        if ((wheel->now & TIMER_WHEEL_SLOT_MASK) == 0)
+            timer_wheel_cascade(wheel);
+    }
+}
+
+/**
+ * @brief 计算下一次需要处理时间轮的时刻
+ *        第0层给出精确的到期时刻，上层给出下移(cascade)的时刻，二者取最小。
+ * @return 时间轮为空返回 -1，否则返回 0
+ */
+TIMER_WHEEL_EXPORT(int timer_wheel_next_expire(const struct timer_wheel *wheel,
+                                               unsigned long long *expire)) {
+    const struct timer_wheel_node *head;
+    unsigned long long base;
+    unsigned long long when;
+    unsigned long long best = 0;
+    unsigned int shift;
+    int found = 0;
+    int level;
+    int d;
+
+    if (wheel->nelts == 0)
+        return -1;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        shift = TIMER_WHEEL_SLOT_BITS * level;
+        base = wheel->now >> shift;
+        for (d = (level == 0) ? 0 : 1; d <= TIMER_WHEEL_SLOTS; d++) {
+            if (level == 0 && d == TIMER_WHEEL_SLOTS)
+                break;
+            head = &wheel->slots[level][(base + d) & TIMER_WHEEL_SLOT_MASK];
+            if (head->next == head)
+                continue;
+            when = (level == 0) ? wheel->now + d : (base + d) << shift;
+            if (!found || when < best)
+                best = when;
+            found = 1;
+            break;
+        }
+    }
+
+    *expire = best;
+    return 0;
+}
+
+#undef TIMER_WHEEL_EXPORT
+
+#endif  /* TIMER_WHEEL_INL_H_ */
@@ -0,0 +1,132 @@
+﻿/*************************************************************************
+ *
+ *   Copyright (C), 2017-2037, BPG. Co., Ltd.
+ *
+ *   文件名称: main.c
+ *   软件模块: LED 闪烁程序演示
+ *   版 本 号: 1.0
+ *   生成日期: 2026-10-17
+ *   作    者: lium
+ *   功    能: 把闪烁程序一次性下发给 /dev/LED4，由驱动中的 hrtimer 播放，
+ *             应用层随后阻塞在 pause() 上，不再为每次亮灭唤醒。
+ *             用法: ./zsf07p [chase|blink] [重复次数，0 表示一直重复]
+ *             Ctrl+C 退出时停止播放并熄灭所有灯。
+ ************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+
+#define LED_DEVICE "/dev/LED4"
+
+#define LED_NUM         4
+#define LED_MASK_ALL    ((1U << LED_NUM) - 1)
+
+/**与驱动中的定义一致，value 的第 i 位为第 i 盏灯的电平(0 亮 1 灭) */
+struct led_batch {
+    unsigned int mask;
+    unsigned int value;
+};
+
+#define LED_PATTERN_MAX_STEPS   32
+
+struct led_step {
+    unsigned int mask;
+    unsigned int value;
+    unsigned int duration_us;
+};
+
+struct led_pattern {
+    unsigned int nsteps;
+    unsigned int repeat;
+    struct led_step steps[LED_PATTERN_MAX_STEPS];
+};
+
+#define LED_MAGIC               'L'
+#define LED_IOCTL_SET_BATCH     _IOW(LED_MAGIC, 0, struct led_batch)
+#define LED_IOCTL_PLAY_PATTERN  _IOW(LED_MAGIC, 2, struct led_pattern)
+#define LED_IOCTL_STOP_PATTERN  _IO(LED_MAGIC, 3)
+
+static volatile sig_atomic_t g_quit = 0;
+
+static void on_signal(int signo) {
+    (void)signo;
+    g_quit = 1;
+}
+
+/**
+ * @brief 跑马灯：每次只点亮一盏，每盏 250ms
+ */
+static void build_chase(struct led_pattern *pat) {
+    unsigned int i;
+
+    pat->nsteps = LED_NUM;
+    for (i = 0; i < LED_NUM; i++) {
+        pat->steps[i].mask = LED_MASK_ALL;
+        pat->steps[i].value = LED_MASK_ALL & ~(1U << i);
+        pat->steps[i].duration_us = 250000;
+    }
+}
+
+/**
+ * @brief 与 app1 相同的节奏：全亮 1s，全灭 1s
+ */
+static void build_blink(struct led_pattern *pat) {
+    pat->nsteps = 2;
+    pat->steps[0].mask = LED_MASK_ALL;
+    pat->steps[0].value = 0;
+    pat->steps[0].duration_us = 1000000;
+    pat->steps[1].mask = LED_MASK_ALL;
+    pat->steps[1].value = LED_MASK_ALL;
+    pat->steps[1].duration_us = 1000000;
+}
+
+int main(int argc, char *argv[]) {
+    struct led_pattern pat;
+    struct led_batch off = { LED_MASK_ALL, LED_MASK_ALL };
+    struct sigaction sa;
+    int fd;
+
+    memset(&pat, 0, sizeof(pat));
+    if (argc > 1 && strcmp(argv[1], "blink") == 0)
+        build_blink(&pat);
+    else
+        build_chase(&pat);
+    pat.repeat = (argc > 2) ? (unsigned int)strtoul(argv[2], NULL, 0) : 0;
+
+    fd = open(LED_DEVICE, O_RDWR);
+    if (fd < 0) {
+        perror("open");
+        fprintf(stderr, "Failed to open device: %s\n", LED_DEVICE);
+        return EXIT_FAILURE;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // 只下发一次，之后的亮灭全部由驱动的 hrtimer 完成
+    if (ioctl(fd, LED_IOCTL_PLAY_PATTERN, &pat) < 0) {
+        perror("ioctl [LED_IOCTL_PLAY_PATTERN]");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    printf("Pattern playing: %u steps, repeat %u. Press Ctrl+C to stop.\n", pat.nsteps, pat.repeat);
+
+    while (!g_quit)
+        pause();
+
+    ioctl(fd, LED_IOCTL_STOP_PATTERN);
+    ioctl(fd, LED_IOCTL_SET_BATCH, &off);
+    close(fd);
+    return 0;
+}
+/*************************************************************************
+ * 改动历史纪录：
+ * Revision 1.0, 2026-10-17, lium
+ * describe: 初始创建.
+ *************************************************************************/
@@ -0,0 +1,244 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: heap_bench.c
+ *   软件模块: 定时器堆性能测试
+ *   功    能: 在主机上测量 heap_inl.h 各操作的平均耗时(ns/op)，用于比较
+ *             指针树实现与数组实现(-DHEAP_USE_ARRAY)，以及不同的分叉数。
+ *             测试项：
+ *             insert      向空堆依次插入 N 个节点
+ *             remove      按随机顺序删除任意节点，直到堆为空
+ *             dequeue     反复取出最小节点，直到堆为空
+ *             reschedule  取出最小节点、到期时刻加一个周期后重新插入，
+ *                         即调度器执行周期任务的路径，堆大小保持 N
+ *             到期时刻的分布：
+ *             random      64 位均匀随机数
+ *             periodic    少数几种周期(1ms~1s)、随机相位，模拟实际的周期任务，
+ *                         大量节点的到期时刻相同或相近
+ *   用    法: ./heap_bench_tree [最大节点数] [重复轮数]
+ *
+ ************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "heap_inl.h"
+
+#define BENCH_MIN_OPS       2000000     /**节点数较少时重复多轮，每项至少执行这么多次操作 */
+#define BENCH_DEFAULT_MAX_N 1000000
+
+#if defined(HEAP_USE_ARRAY)
+# define BENCH_STR_(x)      #x
+# define BENCH_STR(x)       BENCH_STR_(x)
+# define BENCH_VARIANT      "array" BENCH_STR(HEAP_ARRAY_ARITY)
+#else
+# define BENCH_VARIANT      "tree"
+#endif
+
+// container_of 宏
+#ifndef container_of
+# define container_of(ptr, type, member) \
+    ((type*)((char*)(ptr) - (size_t)&((type*)0)->member))
+#endif
+
+/**与调度器中的任务结构体类似：堆节点 + 到期时刻 + 周期 */
+typedef struct TBenchNode_t {
+    struct heap_node node;
+    unsigned long long expire;
+    unsigned long long interval;
+} TBenchNode_t;
+
+typedef enum {
+    BENCH_DIST_RANDOM = 0,
+    BENCH_DIST_PERIODIC
+} TBenchDist_t;
+
+static const char *dist_names[] = { "random", "periodic" };
+
+/**periodic 分布使用的周期(ns) */
+static const unsigned long long periods[] = {
+    1000000ULL, 10000000ULL, 20000000ULL, 50000000ULL,
+    100000000ULL, 500000000ULL, 1000000000ULL
+};
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+static volatile unsigned long long sink;       /**防止编译器把测量的操作优化掉 */
+
+// xorshift64*，比 rand() 快且周期足够长
+static unsigned long long bench_rand(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static unsigned long long bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_less_than(const struct heap_node *a, const struct heap_node *b) {
+    const TBenchNode_t *na = container_of(a, TBenchNode_t, node);
+    const TBenchNode_t *nb = container_of(b, TBenchNode_t, node);
+    return na->expire < nb->expire;
+}
+
+static void bench_fill_keys(TBenchNode_t *nodes, unsigned int n, TBenchDist_t dist) {
+    unsigned int i;
+    unsigned long long period;
+
+    for (i = 0; i < n; i++) {
+        if (dist == BENCH_DIST_RANDOM) {
+            nodes[i].expire = bench_rand() >> 1;
+            nodes[i].interval = 1 + (bench_rand() >> 34);
+        } else {
+            period = periods[bench_rand() % (sizeof(periods) / sizeof(periods[0]))];
+            nodes[i].interval = period;
+            nodes[i].expire = bench_rand() % period;
+        }
+    }
+}
+
+// 打乱删除顺序
+static void bench_shuffle(unsigned int *order, unsigned int n) {
+    unsigned int i;
+    unsigned int j;
+    unsigned int tmp;
+
+    for (i = 0; i < n; i++)
+        order[i] = i;
+    for (i = n; i > 1; i--) {
+        j = (unsigned int)(bench_rand() % i);
+        tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+}
+
+static void bench_release(struct heap *heap) {
+#if defined(HEAP_USE_ARRAY)
+    heap_destroy(heap);
+#else
+    heap_init(heap);
+#endif
+}
+
+static void bench_insert_all(struct heap *heap, TBenchNode_t *nodes, unsigned int n) {
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        heap_insert(heap, &nodes[i].node, bench_less_than);
+}
+
+/**
+ * @brief 测量一种分布、一种规模下的各项操作
+ * @param result 输出 insert/remove/dequeue/reschedule 的 ns/op
+ */
+static void bench_run(unsigned int n, TBenchDist_t dist, unsigned int rounds_hint, double result[4]) {
+    TBenchNode_t *nodes;
+    unsigned int *order;
+    struct heap heap;
+    unsigned long long t_insert = 0;
+    unsigned long long t_remove = 0;
+    unsigned long long t_dequeue = 0;
+    unsigned long long t_resched = 0;
+    unsigned long long resched_ops;
+    unsigned long long start;
+    unsigned long long k;
+    unsigned int rounds;
+    unsigned int r;
+    unsigned int i;
+    TBenchNode_t *task;
+
+    nodes = malloc(n * sizeof(*nodes));
+    order = malloc(n * sizeof(*order));
+    if (nodes == NULL || order == NULL) {
+        fprintf(stderr, "out of memory (n = %u)\n", n);
+        exit(1);
+    }
+
+    rounds = (BENCH_MIN_OPS + n - 1) / n;
+    if (rounds < rounds_hint)
+        rounds = rounds_hint;
+    resched_ops = n < BENCH_MIN_OPS ? BENCH_MIN_OPS : n;
+    heap_init(&heap);
+
+    for (r = 0; r < rounds; r++) {
+        bench_fill_keys(nodes, n, dist);
+
+        start = bench_now_ns();
+        bench_insert_all(&heap, nodes, n);
+        t_insert += bench_now_ns() - start;
+
+        bench_shuffle(order, n);
+        start = bench_now_ns();
+        for (i = 0; i < n; i++)
+            heap_remove(&heap, &nodes[order[i]].node, bench_less_than);
+        t_remove += bench_now_ns() - start;
+        bench_release(&heap);
+
+        bench_insert_all(&heap, nodes, n);
+        start = bench_now_ns();
+        while (heap_min(&heap) != NULL) {
+            sink += container_of(heap_min(&heap), TBenchNode_t, node)->expire;
+            heap_dequeue(&heap, bench_less_than);
+        }
+        t_dequeue += bench_now_ns() - start;
+        bench_release(&heap);
+    }
+
+    // reschedule 与节点数无关地执行固定次数，只做一轮
+    bench_fill_keys(nodes, n, dist);
+    bench_insert_all(&heap, nodes, n);
+    start = bench_now_ns();
+    for (k = 0; k < resched_ops; k++) {
+        task = container_of(heap_min(&heap), TBenchNode_t, node);
+        heap_dequeue(&heap, bench_less_than);
+        task->expire += task->interval;
+        heap_insert(&heap, &task->node, bench_less_than);
+    }
+    t_resched = bench_now_ns() - start;
+    sink += container_of(heap_min(&heap), TBenchNode_t, node)->expire;
+    bench_release(&heap);
+
+    result[0] = (double)t_insert / ((double)n * rounds);
+    result[1] = (double)t_remove / ((double)n * rounds);
+    result[2] = (double)t_dequeue / ((double)n * rounds);
+    result[3] = (double)t_resched / (double)resched_ops;
+
+    free(order);
+    free(nodes);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int max_n = BENCH_DEFAULT_MAX_N;
+    unsigned int rounds_hint = 1;
+    unsigned int n;
+    double result[4];
+    int dist;
+
+    if (argc > 1)
+        max_n = (unsigned int)strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        rounds_hint = (unsigned int)strtoul(argv[2], NULL, 0);
+    if (max_n < 10 || rounds_hint == 0) {
+        fprintf(stderr, "usage: %s [max_nodes >= 10] [rounds >= 1]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-8s %-9s %8s %10s %10s %10s %10s   (ns/op)\n",
+           "variant", "dist", "nodes", "insert", "remove", "dequeue", "reschedule");
+    for (dist = BENCH_DIST_RANDOM; dist <= BENCH_DIST_PERIODIC; dist++) {
+        for (n = 10; n <= max_n; n *= 10) {
+            bench_run(n, (TBenchDist_t)dist, rounds_hint, result);
+            printf("%-8s %-9s %8u %10.1f %10.1f %10.1f %10.1f\n",
+                   BENCH_VARIANT, dist_names[dist], n,
+                   result[0], result[1], result[2], result[3]);
+            fflush(stdout);
+            if (n > max_n / 10)
+                break;
+        }
+    }
+
+    return 0;
+}
@@ -8,6 +8,9 @@
  *   生成日期: 2025-09-08
  *   作    者: lium
  *   功    能: 通过GPIO口函数控制LED灯
+ *             write: 每 2 个字节为一组(灯序号, 状态)，一次可以写多组
+ *             ioctl: LED_IOCTL_SET_BATCH 按 mask/value 一次设置多盏灯
+ *                    LED_IOCTL_PLAY_PATTERN 下发闪烁程序，由内核 hrtimer 按步播放
  *
  ************************************************************************/
 #include <linux/module.h>
@@ -17,10 +20,57 @@
 #include <linux/fs.h>           // 文件操作集
 #include <linux/device.h>       // create_device
 #include <linux/gpio.h>         // gpio口相关函数
+#include <linux/ioctl.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 #include <cfg_type.h>
 
-#define BUF_SIZE    2                   // 接收应用层数据的个数
-static char dataBuf[BUF_SIZE];
+#include "drv_stats.h"
+#define CREATE_TRACE_POINTS
+#include "led07_trace.h"
+
+#define BUF_SIZE    32                  // 每次从应用层拷贝的字节数(16 组)
+
+#define LED_NUM         4
+#define LED_MASK_ALL    ((1U << LED_NUM) - 1)
+
+/**
+ * 批量设置：mask 的第 i 位为 1 表示设置第 i 盏灯，value 的第 i 位为该灯的电平
+ * (与 write 中的状态一致，0 亮 1 灭)
+ */
+struct led_batch {
+    unsigned int mask;
+    unsigned int value;
+};
+
+#define LED_MAGIC           'L'
+#define LED_IOCTL_SET_BATCH _IOW(LED_MAGIC, 0, struct led_batch)   // 按 mask/value 设置
+#define LED_IOCTL_GET_STATE _IOR(LED_MAGIC, 1, unsigned int)       // 读取当前各灯电平
+
+#define LED_PATTERN_MAX_STEPS   32      // 一个闪烁程序最多的步数
+#define LED_PATTERN_MIN_US      20      // 每一步的最短持续时间，避免定时器中断占满 CPU
+
+/**闪烁程序的一步：按 mask/value 设置灯，然后保持 duration_us 微秒 */
+struct led_step {
+    unsigned int mask;
+    unsigned int value;
+    unsigned int duration_us;
+};
+
+/**
+ * 闪烁程序：依次执行 steps[0..nsteps-1]，整体重复 repeat 次，repeat 为 0 表示一直重复。
+ * 有限次数时最后一步执行后即结束，灯保持最后一步的状态。
+ */
+struct led_pattern {
+    unsigned int nsteps;
+    unsigned int repeat;
+    struct led_step steps[LED_PATTERN_MAX_STEPS];
+};
+
+#define LED_IOCTL_PLAY_PATTERN  _IOW(LED_MAGIC, 2, struct led_pattern)  // 开始播放，替换正在播放的程序
+#define LED_IOCTL_STOP_PATTERN  _IO(LED_MAGIC, 3)                       // 停止播放，灯保持当前状态
 
 static unsigned int majorDevID = 0;     // 主设备号（动态分配）
 static unsigned int minorDevID = 0;     // 次设备号
@@ -35,17 +85,43 @@ struct device *pDeviceLed;
 #define GPIOC8   (PAD_GPIO_C + 8)
 #define GPIOC7   (PAD_GPIO_C + 7)
 
-unsigned int led_gpio[4] = {GPIOE13, GPIOC17, GPIOC8, GPIOC7};
+unsigned int led_gpio[LED_NUM] = {GPIOE13, GPIOC17, GPIOC8, GPIOC7};
+
+static DEFINE_SPINLOCK(led_lock);       // 保证一组灯的设置不会与其他调用交错
+static unsigned int led_state = LED_MASK_ALL;   // 各灯当前电平，打开设备时全部为高(灭)
+
+/**闪烁程序的播放状态，只在定时器停止时由 ioctl 修改，播放中只由定时器回调访问 */
+static struct hrtimer led_pat_timer;
+static DEFINE_MUTEX(led_pat_mutex);     // 串行化 PLAY/STOP/close
+static struct led_pattern led_pat;
+static unsigned int led_pat_index;      // 下一次要执行的步
+static unsigned int led_pat_left;       // 剩余的重复次数(repeat 为 0 时不使用)
+static ktime_t led_pat_next;            // 下一次执行的绝对时刻，按 duration 累加，不累积误差
+
+/**debugfs 计数器：/sys/kernel/debug/led07/stats */
+enum {
+    LED_STAT_WRITES = 0,
+    LED_STAT_IOCTLS,
+    LED_STAT_PATTERN_STEPS,
+    LED_STAT_ERRORS,
+    LED_STAT_NUM
+};
+static const char *const led_stat_names[LED_STAT_NUM] = { "writes", "ioctls", "pattern_steps", "errors" };
+static struct drv_stats led_stats;
 
 static int led_open(struct inode *inode, struct file *pFile);
 static int led_close(struct inode *inode, struct file *pFile);
 static ssize_t led_write(struct file *file, const char __user *buf, size_t len, loff_t *off);
+static long led_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+static enum hrtimer_restart led_pattern_timer_fn(struct hrtimer *timer);
+static void led_pattern_stop(void);
 
 static const struct file_operations led_fops = {
     .owner      = THIS_MODULE,
     .open       = led_open,
     .release    = led_close,
     .write      = led_write,
+    .unlocked_ioctl = led_ioctl,
 };
 
 static int __init chrDevInit(void)
@@ -65,6 +141,9 @@ static int __init chrDevInit(void)
         return ret;
     }
 
+    hrtimer_init(&led_pat_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+    led_pat_timer.function = led_pattern_timer_fn;
+
     /**2. 字符设备初始化 */
     cdev_init(&chrdev, &led_fops);
     chrdev.owner = THIS_MODULE;
@@ -94,6 +173,7 @@ static int __init chrDevInit(void)
         goto err_device_create;
     }
 
+    drv_stats_init(&led_stats, "led07", led_stat_names, LED_STAT_NUM);
     printk(KERN_INFO "LED driver initialized successfully (major=%d)\n", majorDevID);
     return 0;
 
@@ -109,6 +189,9 @@ err_cdev_add:
 
 static void __exit chrDevExit(void)
 {
+    led_pattern_stop();
+    drv_stats_exit(&led_stats);
+
     if (pDeviceLed)
         device_destroy(pClassLed, dev_no);
 
@@ -136,6 +219,7 @@ static int led_open(struct inode *inode, struct file *pFile)
         /**GPIO口设置为输出模式，并且默认为高电平 */
         gpio_direction_output(led_gpio[i], 1);
     }
+    led_state = LED_MASK_ALL;
     printk(KERN_INFO "led_open success! \n");
     return ret;
 }
@@ -144,6 +228,9 @@ static int led_close(struct inode *inode, struct file *pFile)
 {
     int i;
 
+    /**停止播放，定时器回调不会再访问 GPIO */
+    led_pattern_stop();
+
     /**释放GPIO */
     for(i = 0; i < 4; i++){
         gpio_free(led_gpio[i]);
@@ -153,39 +240,176 @@ static int led_close(struct inode *inode, struct file *pFile)
 }
 
 /**
- * @brief 控制LED灯；
- * @param buf[0] 表示控制哪一盏灯
- * @param buf[1] 表示亮还什么灭
+ * @brief 在一次加锁中设置多盏灯
+ * @param mask  第 i 位为 1 表示设置第 i 盏灯
+ * @param value 第 i 位为第 i 盏灯的电平
+ */
+static void led_apply(unsigned int mask, unsigned int value)
+{
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&led_lock, flags);
+    for (i = 0; i < LED_NUM; i++) {
+        if (mask & (1U << i)) {
+            gpio_set_value(led_gpio[i], (value >> i) & 1);
+            trace_led07_write("LED4", led_gpio[i], (value >> i) & 1);
+        }
+    }
+    led_state = (led_state & ~mask) | (value & mask);
+    spin_unlock_irqrestore(&led_lock, flags);
+}
+
+/**
+ * @brief 控制LED灯，每 2 个字节为一组，一次可以写多组
+ * @param buf[2n]   表示控制哪一盏灯 '0'~'3'
+ * @param buf[2n+1] 表示亮还是灭 '0' 亮 '1' 灭
+ * @return 处理的字节数；末尾不成组的 1 个字节不处理，不计入返回值
  */
 static ssize_t led_write(struct file *file, const char __user *buf, size_t len, loff_t *off)
 {
-    int ret, i;
+    char dataBuf[BUF_SIZE];
+    unsigned int mask;
+    unsigned int value;
+    size_t done = 0;
+    size_t copy_len;
     int ledNum;     // 那一盏灯
     int status;     // 灯的状状态
-    size_t copy_len = len;
+    int ret, i;
+
+    len &= ~(size_t)1;
+    if (len == 0)
+        return -EINVAL;
+
+    while (done < len) {
+        copy_len = min_t(size_t, len - done, BUF_SIZE);
+
+        /**将用户数据拷贝到缓冲区 */
+        ret = copy_from_user(dataBuf, buf + done, copy_len);
+        if (ret != 0) {
+            drv_stats_inc(&led_stats, LED_STAT_ERRORS);
+            pr_debug("led_write: copy_from_user failed, %d bytes not copied\n", ret);
+            return done ? (ssize_t)done : -EFAULT;
+        }
 
-    if (copy_len > BUF_SIZE)
-    {
-        copy_len = BUF_SIZE;
+        /**同一个缓冲区里的各组合并成一次设置，后面的组覆盖前面的组 */
+        mask = 0;
+        value = 0;
+        for (i = 0; i < copy_len; i += 2) {
+            ledNum = dataBuf[i] - '0';
+            status = dataBuf[i + 1] - '0';
+            if (ledNum < 0 || ledNum >= LED_NUM || (status != 0 && status != 1)) {
+                if (mask)
+                    led_apply(mask, value);
+                drv_stats_inc(&led_stats, LED_STAT_ERRORS);
+                done += i;
+                return done ? (ssize_t)done : -EINVAL;
+            }
+            mask |= 1U << ledNum;
+            value = (value & ~(1U << ledNum)) | ((unsigned int)status << ledNum);
+        }
+        led_apply(mask, value);
+        done += copy_len;
     }
 
-    /**将用户数据拷贝到缓冲区 */
-    ret = copy_from_user(dataBuf, buf, copy_len);
-    if (ret != 0) {
-        printk(KERN_ERR "led_write: copy_from_user failed, %d bytes not copied\n", ret);
-        return -EFAULT;
+    drv_stats_inc(&led_stats, LED_STAT_WRITES);
+    pr_debug("led_write: %zu bytes, state 0x%x\n", done, led_state);
+    return done;
+}
+
+/**
+ * @brief 定时器回调(中断上下文)：执行当前步，并把定时器推到下一步的绝对时刻
+ */
+static enum hrtimer_restart led_pattern_timer_fn(struct hrtimer *timer)
+{
+    const struct led_step *step = &led_pat.steps[led_pat_index];
+
+    led_apply(step->mask, step->value);
+    drv_stats_inc(&led_stats, LED_STAT_PATTERN_STEPS);
+
+    if (++led_pat_index == led_pat.nsteps) {
+        led_pat_index = 0;
+        if (led_pat.repeat != 0 && --led_pat_left == 0)
+            return HRTIMER_NORESTART;
     }
 
-    /**打印接收到的数据 */
-    printk(KERN_INFO "led_write: received %zu bytes: %.*s\n", copy_len, (int)copy_len, dataBuf);
-    for (i = 0; i < copy_len; i++) {
-        printk(KERN_INFO "received [%d]: '%c' (0x%02X)\n", i, dataBuf[i], dataBuf[i]);
+    // 相对上一次的计划时刻累加，而不是相对回调实际执行的时刻，中断延迟不会累积
+    led_pat_next = ktime_add_us(led_pat_next, step->duration_us);
+    hrtimer_set_expires(timer, led_pat_next);
+    return HRTIMER_RESTART;
+}
+
+static void led_pattern_stop(void)
+{
+    mutex_lock(&led_pat_mutex);
+    hrtimer_cancel(&led_pat_timer);
+    mutex_unlock(&led_pat_mutex);
+}
+
+/**
+ * @brief 检查并开始播放闪烁程序，第一步立即执行
+ */
+static int led_pattern_play(const struct led_pattern *pat)
+{
+    unsigned int i;
+
+    if (pat->nsteps == 0 || pat->nsteps > LED_PATTERN_MAX_STEPS)
+        return -EINVAL;
+    for (i = 0; i < pat->nsteps; i++) {
+        if ((pat->steps[i].mask & ~LED_MASK_ALL) ||
+            pat->steps[i].duration_us < LED_PATTERN_MIN_US)
+            return -EINVAL;
     }
 
-    /**控制LED的逻辑 */
-    ledNum = dataBuf[0] - '0';
-    status = dataBuf[1] - '0';
-    gpio_set_value(led_gpio[ledNum], status);
+    mutex_lock(&led_pat_mutex);
+    hrtimer_cancel(&led_pat_timer);
+
+    led_pat = *pat;
+    led_pat_index = 0;
+    led_pat_left = pat->repeat;
+    led_pat_next = ktime_get();
+    hrtimer_start(&led_pat_timer, led_pat_next, HRTIMER_MODE_ABS);
+    mutex_unlock(&led_pat_mutex);
+    return 0;
+}
+
+/**
+ * @brief LED_IOCTL_SET_BATCH 一次系统调用设置多盏灯，LED_IOCTL_GET_STATE 读取当前电平
+ *        LED_IOCTL_PLAY_PATTERN/LED_IOCTL_STOP_PATTERN 播放/停止闪烁程序
+ */
+static long led_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct led_batch batch;
+    struct led_pattern pat;
+    unsigned int state;
+
+    if (_IOC_TYPE(cmd) != LED_MAGIC)
+        return -ENOTTY;
+
+    drv_stats_inc(&led_stats, LED_STAT_IOCTLS);
+    switch (cmd) {
+        case LED_IOCTL_SET_BATCH:
+            if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+                return -EFAULT;
+            if (batch.mask & ~LED_MASK_ALL)
+                return -EINVAL;
+            led_apply(batch.mask, batch.value);
+            break;
+        case LED_IOCTL_GET_STATE:
+            state = led_state;
+            if (copy_to_user((void __user *)arg, &state, sizeof(state)))
+                return -EFAULT;
+            break;
+        case LED_IOCTL_PLAY_PATTERN:
+            if (copy_from_user(&pat, (void __user *)arg, sizeof(pat)))
+                return -EFAULT;
+            return led_pattern_play(&pat);
+        case LED_IOCTL_STOP_PATTERN:
+            led_pattern_stop();
+            break;
+        default:
+            return -ENOTTY;
+    }
     return 0;
 }
 
@@ -200,4 +424,11 @@ MODULE_VERSION("2025-09-08_V1.1");
  * 改动历史纪录：
  * Revision 1.0, 2025-08-31, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-16, lium
+ * describe: write 一次处理多组并返回实际字节数，新增 LED_IOCTL_SET_BATCH 批量设置.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 新增 hrtimer 闪烁程序引擎，LED_IOCTL_PLAY_PATTERN/LED_IOCTL_STOP_PATTERN.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 引脚电平变化记录为 led07_write 跟踪点，写路径错误改为 pr_debug，
+ *           增加 debugfs 计数器 /sys/kernel/debug/led07/stats.
  *************************************************************************/
\ No newline at end of file
@@ -0,0 +1,220 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: event_loop_inl.h
+ *   软件模块: 事件循环
+ *   功    能: 取代主循环里对 clock_gettime 的忙等轮询：
+ *             1. 用 timerfd(TFD_TIMER_ABSTIME) 定到调度器中最早任务的到期时刻；
+ *             2. 进程阻塞在 epoll_wait 上，定时器到期或设备 fd 就绪时才被唤醒；
+ *             空闲时几乎不占 CPU，定时精度由内核 hrtimer 保证(亚毫秒级)。
+ *             3. 可选：收到指定信号(如 SIGUSR1)时输出任务统计。
+ *
+ ************************************************************************/
+#ifndef EVENT_LOOP_INL_H_
+#define EVENT_LOOP_INL_H_
+
+#include "sched_inl.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+#if defined(__GNUC__)
+# define EVENT_LOOP_EXPORT(declaration) __attribute__((unused)) static declaration
+#else
+# define EVENT_LOOP_EXPORT(declaration) static declaration
+#endif
+
+#define EVENT_LOOP_MAX_EVENTS   16      /**一次 epoll_wait 最多取回的事件数 */
+
+/**fd 观察者：fd 就绪时在事件循环线程中调用 callback */
+typedef struct TEventWatcher_t {
+    int fd;
+    unsigned int events;                /**关注的事件，EPOLLIN/EPOLLOUT/EPOLLPRI... */
+    void (*callback)(struct TEventWatcher_t *watcher, unsigned int revents);
+    void *arg;                          /**用户数据 */
+} TEventWatcher_t;
+
+/**事件循环 */
+typedef struct TEventLoop_t {
+    int epfd;
+    TEventWatcher_t timer;              /**timerfd 观察者 */
+    TEventWatcher_t stats_signal;       /**signalfd 观察者，收到信号时输出任务统计 */
+    const char *stats_path;             /**统计输出文件，NULL 表示 stderr */
+    TScheduler_t *sched;
+    volatile int running;
+} TEventLoop_t;
+
+/**timerfd 可读只表示到期了，读掉计数即可，到期任务由 event_loop_run_once 统一执行 */
+static void event_loop_timer_cb(TEventWatcher_t *watcher, unsigned int revents) {
+    uint64_t expirations;
+    (void)revents;
+    while (read(watcher->fd, &expirations, sizeof(expirations)) < 0 && errno == EINTR)
+        ;
+}
+
+/**
+ * @brief 初始化事件循环
+ * @return 成功返回 0，失败返回 -1 (errno 有效)
+ */
+EVENT_LOOP_EXPORT(int event_loop_init(TEventLoop_t *loop, TScheduler_t *sched)) {
+    struct epoll_event ev;
+
+    memset(loop, 0, sizeof(*loop));
+    loop->sched = sched;
+    loop->stats_signal.fd = -1;
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0)
+        return -1;
+
+    loop->timer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (loop->timer.fd < 0) {
+        close(loop->epfd);
+        return -1;
+    }
+    loop->timer.events = EPOLLIN;
+    loop->timer.callback = event_loop_timer_cb;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = &loop->timer;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->timer.fd, &ev) < 0) {
+        close(loop->timer.fd);
+        close(loop->epfd);
+        return -1;
+    }
+
+    loop->running = 1;
+    return 0;
+}
+
+/**
+ * @brief 关注设备 fd，watcher 的内存由调用者保证在删除之前有效
+ */
+EVENT_LOOP_EXPORT(int event_loop_add_fd(TEventLoop_t *loop, TEventWatcher_t *watcher)) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = watcher->events;
+    ev.data.ptr = watcher;
+    return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, watcher->fd, &ev);
+}
+
+EVENT_LOOP_EXPORT(int event_loop_del_fd(TEventLoop_t *loop, TEventWatcher_t *watcher)) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    return epoll_ctl(loop->epfd, EPOLL_CTL_DEL, watcher->fd, &ev);
+}
+
+static void event_loop_stats_cb(TEventWatcher_t *watcher, unsigned int revents) {
+    TEventLoop_t *loop = (TEventLoop_t *)watcher->arg;
+    struct signalfd_siginfo info;
+    (void)revents;
+
+    while (read(watcher->fd, &info, sizeof(info)) == sizeof(info))
+        ;
+    sched_dump_stats(loop->sched, loop->stats_path);
+}
+
+/**
+ * @brief 收到 signo 信号时输出任务统计(在事件循环线程中，不在信号处理函数里)
+ * @param path 追加写入的文件，NULL 表示输出到 stderr
+ */
+EVENT_LOOP_EXPORT(int event_loop_dump_stats_on_signal(TEventLoop_t *loop, int signo, const char *path)) {
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+        return -1;
+
+    loop->stats_signal.fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (loop->stats_signal.fd < 0)
+        return -1;
+    loop->stats_signal.events = EPOLLIN;
+    loop->stats_signal.callback = event_loop_stats_cb;
+    loop->stats_signal.arg = loop;
+    loop->stats_path = path;
+
+    return event_loop_add_fd(loop, &loop->stats_signal);
+}
+
+/**
+ * @brief 把 timerfd 定到最早任务的到期时刻，没有任务时关闭定时器
+ *        任务时刻本身就是 CLOCK_MONOTONIC 纳秒，直接作为绝对时间使用。
+ */
+static int event_loop_arm_timer(TEventLoop_t *loop) {
+    struct itimerspec its;
+    unsigned long long expire;
+
+    memset(&its, 0, sizeof(its));
+    if (sched_next_expire(loop->sched, &expire) == 0) {
+        if (expire == 0)
+            expire = 1;             // it_value 全为 0 表示关闭定时器
+        its.it_value.tv_sec = expire / SCHED_NSEC_PER_SEC;
+        its.it_value.tv_nsec = expire % SCHED_NSEC_PER_SEC;
+    }
+    return timerfd_settime(loop->timer.fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * @brief 执行到期任务，然后阻塞到下一个任务到期或有 fd 就绪
+ * @return 成功返回 0，出错返回 -1
+ */
+EVENT_LOOP_EXPORT(int event_loop_run_once(TEventLoop_t *loop)) {
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    TEventWatcher_t *watcher;
+    int n;
+    int i;
+
+    sched_run_pending(loop->sched, get_current_time_ns());
+
+    if (event_loop_arm_timer(loop) < 0)
+        return -1;
+
+    n = epoll_wait(loop->epfd, events, EVENT_LOOP_MAX_EVENTS, -1);
+    if (n < 0)
+        return (errno == EINTR) ? 0 : -1;
+
+    for (i = 0; i < n; i++) {
+        watcher = (TEventWatcher_t *)events[i].data.ptr;
+        watcher->callback(watcher, events[i].events);
+    }
+    return 0;
+}
+
+/**
+ * @brief 运行事件循环，直到 event_loop_stop() 或出错
+ */
+EVENT_LOOP_EXPORT(int event_loop_run(TEventLoop_t *loop)) {
+    while (loop->running) {
+        if (event_loop_run_once(loop) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+EVENT_LOOP_EXPORT(void event_loop_stop(TEventLoop_t *loop)) {
+    loop->running = 0;
+}
+
+EVENT_LOOP_EXPORT(void event_loop_close(TEventLoop_t *loop)) {
+    if (loop->stats_signal.fd >= 0)
+        close(loop->stats_signal.fd);
+    loop->stats_signal.fd = -1;
+    if (loop->timer.fd >= 0)
+        close(loop->timer.fd);
+    if (loop->epfd >= 0)
+        close(loop->epfd);
+    loop->timer.fd = -1;
+    loop->epfd = -1;
+}
+
+#undef EVENT_LOOP_EXPORT
+
+#endif  /* EVENT_LOOP_INL_H_ */
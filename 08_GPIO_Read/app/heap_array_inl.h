@@ -0,0 +1,229 @@
+﻿#ifndef UV_SRC_HEAP_ARRAY_H_
+#define UV_SRC_HEAP_ARRAY_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__)
+# define HEAP_EXPORT(declaration) __attribute__((unused)) static declaration
+#else
+# define HEAP_EXPORT(declaration) static declaration
+#endif
+
+/* Number of children per node.  4 keeps all siblings of a node in one or two
+ * cache lines of the pointer array and halves the tree height compared to a
+ * binary heap; define HEAP_ARRAY_ARITY=2 to get a classic binary heap.
+ */
+#ifndef HEAP_ARRAY_ARITY
+# define HEAP_ARRAY_ARITY 4
+#endif
+
+#define HEAP_ARRAY_MIN_CAPACITY 16
+
+/* Index of a node that is not linked into any heap. */
+#define HEAP_INVALID_INDEX ((unsigned int)-1)
+
+/* The node only remembers its slot in the array.  The node pointer itself is
+ * the stable handle: it stays valid while the node moves around in the array,
+ * so heap_remove() finds it in O(1) and fixes the heap in O(log n).
+ */
+struct heap_node {
+    unsigned int index;
+};
+
+/* An implicit d-ary min heap.  nodes[0] is the lowest element and the
+ * children of nodes[i] are nodes[i * HEAP_ARRAY_ARITY + 1 ...].  Sifting
+ * moves pointers inside one contiguous array instead of relinking three
+ * pointers per level like the tree based heap_inl.h does.
+ */
+struct heap {
+    struct heap_node **nodes;
+    unsigned int nelts;
+    unsigned int capacity;
+};
+
+/* Return non-zero if a < b. */
+typedef int (*heap_compare_fn)(const struct heap_node *a,
+                               const struct heap_node *b);
+
+/* Public functions. */
+HEAP_EXPORT(void heap_init(struct heap *heap));
+
+HEAP_EXPORT(struct heap_node *heap_min(const struct heap *heap));
+
+HEAP_EXPORT(void heap_insert(struct heap *heap,
+                             struct heap_node *newnode,
+                    heap_compare_fn less_than));
+
+HEAP_EXPORT(void heap_remove(struct heap *heap,
+                             struct heap_node *node,
+                    heap_compare_fn less_than));
+
+HEAP_EXPORT(void heap_dequeue(struct heap *heap, heap_compare_fn less_than));
+
+/* Array only extras: pre-size the array so heap_insert() never reallocates on
+ * the scheduling path, and release the array when the heap is no longer used.
+ */
+HEAP_EXPORT(int heap_reserve(struct heap *heap, unsigned int capacity));
+
+HEAP_EXPORT(void heap_destroy(struct heap *heap));
+
+/* Implementation follows. */
+
+HEAP_EXPORT(void heap_init(struct heap *heap)) {
+    heap->nodes = NULL;
+    heap->nelts = 0;
+    heap->capacity = 0;
+}
+
+HEAP_EXPORT(struct heap_node *heap_min(const struct heap *heap)) {
+    if (heap->nelts == 0)
+        return NULL;
+    return heap->nodes[0];
+}
+
+HEAP_EXPORT(int heap_reserve(struct heap *heap, unsigned int capacity)) {
+    struct heap_node **nodes;
+
+    if (capacity <= heap->capacity)
+        return 0;
+
+    nodes = realloc(heap->nodes, capacity * sizeof(*nodes));
+    if (nodes == NULL)
+        return -1;
+
+    heap->nodes = nodes;
+    heap->capacity = capacity;
+    return 0;
+}
+
+HEAP_EXPORT(void heap_destroy(struct heap *heap)) {
+    free(heap->nodes);
+    heap_init(heap);
+}
+
+/* Move `node` from slot `index` towards the root until its parent is smaller.
+ * Parents are shifted down into the hole, the node is stored once at the end.
+ */
+static void heap_array_sift_up(struct heap *heap,
+                               unsigned int index,
+                               struct heap_node *node,
+                               heap_compare_fn less_than) {
+    struct heap_node *parent;
+    unsigned int pindex;
+
+    while (index > 0) {
+        pindex = (index - 1) / HEAP_ARRAY_ARITY;
+        parent = heap->nodes[pindex];
+        if (!less_than(node, parent))
+            break;
+        heap->nodes[index] = parent;
+        parent->index = index;
+        index = pindex;
+    }
+
+    heap->nodes[index] = node;
+    node->index = index;
+}
+
+/* Move `node` from slot `index` away from the root until all its children are
+ * bigger.  The smallest child is shifted up into the hole at every level.
+ */
+static void heap_array_sift_down(struct heap *heap,
+                                 unsigned int index,
+                                 struct heap_node *node,
+                                 heap_compare_fn less_than) {
+    struct heap_node *smallest;
+    unsigned int first;
+    unsigned int last;
+    unsigned int sindex;
+    unsigned int k;
+
+    for (;;) {
+        first = index * HEAP_ARRAY_ARITY + 1;
+        if (first >= heap->nelts)
+            break;
+
+        last = first + HEAP_ARRAY_ARITY;
+        if (last > heap->nelts)
+            last = heap->nelts;
+
+        sindex = first;
+        smallest = heap->nodes[first];
+        for (k = first + 1; k < last; k++) {
+            if (less_than(heap->nodes[k], smallest)) {
+                sindex = k;
+                smallest = heap->nodes[k];
+            }
+        }
+
+        if (!less_than(smallest, node))
+            break;
+
+        heap->nodes[index] = smallest;
+        smallest->index = index;
+        index = sindex;
+    }
+
+    heap->nodes[index] = node;
+    node->index = index;
+}
+
+HEAP_EXPORT(void heap_insert(struct heap *heap,
+                             struct heap_node *newnode,
+                    heap_compare_fn less_than)) {
+    unsigned int capacity;
+
+    if (heap->nelts == heap->capacity) {
+        capacity = heap->capacity * 2;
+        if (capacity < HEAP_ARRAY_MIN_CAPACITY)
+            capacity = HEAP_ARRAY_MIN_CAPACITY;
+        /* heap_insert() has no way to report failure (same signature as the
+         * tree heap), call heap_reserve() up front if that matters.
+         */
+        if (heap_reserve(heap, capacity) != 0)
+            abort();
+    }
+
+    heap->nelts += 1;
+    heap_array_sift_up(heap, heap->nelts - 1, newnode, less_than);
+}
+
+HEAP_EXPORT(void heap_remove(struct heap *heap,
+                             struct heap_node *node,
+                    heap_compare_fn less_than)) {
+    struct heap_node *last;
+    unsigned int index;
+
+    if (heap->nelts == 0 || node == NULL)
+        return;
+
+    index = node->index;
+    if (index >= heap->nelts || heap->nodes[index] != node)
+        return;
+
+    heap->nelts -= 1;
+    node->index = HEAP_INVALID_INDEX;
+
+    /* Removing the last slot, nothing to fix up. */
+    if (index == heap->nelts)
+        return;
+
+    /* Move the last node into the hole and restore the heap property in
+     * whichever direction it is violated.
+     */
+    last = heap->nodes[heap->nelts];
+    if (index > 0 &&
+        less_than(last, heap->nodes[(index - 1) / HEAP_ARRAY_ARITY]))
+        heap_array_sift_up(heap, index, last, less_than);
+    else
+        heap_array_sift_down(heap, index, last, less_than);
+}
+
+HEAP_EXPORT(void heap_dequeue(struct heap *heap, heap_compare_fn less_than)) {
+    heap_remove(heap, heap_min(heap), less_than);
+}
+
+#undef HEAP_EXPORT
+
+#endif  /* UV_SRC_HEAP_ARRAY_H_ */
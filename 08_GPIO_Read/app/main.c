@@ -7,9 +7,10 @@
  *   版 本 号: 1.0
  *   生成日期: 2025-09-08
  *   作    者: lium
- *   功    能:  任务A：每隔2秒读取一次数据
+ *   功    能:  等待 PIR 的电平变化事件：驱动在边沿中断中记录 {时间戳, 电平}，
+ *               设备 fd 加入事件循环，有事件时才被唤醒，不再定时轮询
  ************************************************************************/
-#include "heap_inl.h"
+#include "event_loop_inl.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -21,103 +22,112 @@
 
 #define PIR_DEVICE "/dev/PIR"
 
-// 全局文件描述符
-static int g_led_fd = -1;
-
-// container_of 宏
-#ifndef container_of
-# define container_of(ptr, type, member) \
-    ((type*)((char*)(ptr) - (size_t)&((type*)0)->member))
-#endif
+/**与驱动中的定义一致 */
+struct pir_event {
+    unsigned long long timestamp_ns;    // 中断发生时刻，CLOCK_MONOTONIC
+    unsigned int level;                 // 边沿之后的电平，1 有人 0 无人
+    unsigned int dropped;               // 此事件之前因队列满而丢弃的事件数
+};
 
-/**任务结构体 */
-typedef struct TTaskControlBlock_t {
-    struct heap_node node;
-    unsigned int expire_time;    /**初始时执行任务的时刻 */
-    unsigned int interval;       /**下一次执行任务的时刻 */
-    char name[32];               /**执行任务的名称 */     
-    void (*callback)(struct TTaskControlBlock_t*);
-} TTaskControlBlock_t;
+#define PIR_READ_BATCH  16              // 一次 read 最多取出的事件数
 
-// 堆比较函数
-int timer_less_than(const struct heap_node *a, const struct heap_node *b) {
-    const TTaskControlBlock_t *ta = container_of(a, TTaskControlBlock_t, node);
-    const TTaskControlBlock_t *tb = container_of(b, TTaskControlBlock_t, node);
-    return ta->expire_time < tb->expire_time;
-}
-
-// 获取当前时间（毫秒）
-unsigned int get_current_time_ms(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (unsigned int)(ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL);
-}
-
-// 重新调度周期性任务
-void reschedule_timer(struct heap *heap, TTaskControlBlock_t *timer, unsigned int current_time) {
-    heap_remove(heap, &timer->node, timer_less_than);
-    timer->expire_time = current_time + timer->interval;
-    heap_insert(heap, &timer->node, timer_less_than);
-}
+// 全局文件描述符
+static int g_pir_fd = -1;
+
+// --- 回调函数：fd 可读时取出所有事件 ---
+static void on_pir_readable(TEventWatcher_t *w, unsigned int revents) {
+    struct pir_event events[PIR_READ_BATCH];
+    unsigned long long now;
+    ssize_t ret;
+    int i, n;
+    (void)revents;
+
+    for (;;) {
+        ret = read(w->fd, events, sizeof(events));
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                perror("read failed");
+            break;
+        }
 
-// --- 回调函数 ---
-void task_read_pir(TTaskControlBlock_t *t) {
-    unsigned char buf[1] = {'0'}; 
-    ssize_t ret = read(g_led_fd, buf, 1);
-    if (ret < 0) {
-        perror("read failed");
-        fprintf(stderr, "read data failed from PIR \n");
-    } else {
-        printf("application layer read data success from PIR %c \n", buf[0]);
+        now = get_current_time_ns();
+        n = (int)(ret / sizeof(events[0]));
+        for (i = 0; i < n; i++) {
+            if (events[i].dropped)
+                printf("PIR: %u events dropped\n", events[i].dropped);
+            printf("PIR: %s at %llu.%06llu s (latency %llu us)\n",
+                   events[i].level ? "motion" : "idle",
+                   events[i].timestamp_ns / SCHED_NSEC_PER_SEC,
+                   events[i].timestamp_ns % SCHED_NSEC_PER_SEC / 1000ULL,
+                   (now - events[i].timestamp_ns) / 1000ULL);
+        }
+        if (n < PIR_READ_BATCH)
+            break;
     }
+    fflush(stdout);
 }
 
 int main() {
-    // 1. 打开设备
-    g_led_fd = open(PIR_DEVICE, O_RDWR);
-    if (g_led_fd < 0) {
+    // 1. 打开设备，非阻塞：由 epoll 通知可读
+    g_pir_fd = open(PIR_DEVICE, O_RDONLY | O_NONBLOCK);
+    if (g_pir_fd < 0) {
         perror("open");
         fprintf(stderr, "Failed to open device: %s\n", PIR_DEVICE);
         return EXIT_FAILURE;
     }
     printf("Application: opened %s successfully\n", PIR_DEVICE);
 
-    // 2. 初始化任务调度器
-    struct heap timer_heap;
-    heap_init(&timer_heap);
-
-    // 3. 创建PIR任务
-    TTaskControlBlock_t task_on = {0};
-    task_on.expire_time = get_current_time_ms();
-    task_on.interval     = 2000;
-    strcpy(task_on.name, "PIR_TASK");
-    task_on.callback     = task_read_pir;  // 类型匹配
-
-    // 5. 插入任务
-    heap_insert(&timer_heap, &task_on.node, timer_less_than);
+    // 2. 初始化任务调度器(本程序没有定时任务，只用事件循环等待 fd)
+    TScheduler_t sched;
+    sched_init(&sched, get_current_time_ns());
 
-    printf("PIR_TASK blinking started (1Hz). Press Ctrl+C to stop.\n");
+    // 打开任务统计：kill -USR1 <pid> 输出迟到时间和回调耗时，设置环境变量 SCHED_STATS_FILE 则追加写入该文件
+    sched_enable_stats(&sched);
 
-    // 6. 主循环
-    while (1) {
-        unsigned int current_time = get_current_time_ms();
-
-        while (heap_min(&timer_heap) != NULL) {
-            TTaskControlBlock_t *timer = container_of(heap_min(&timer_heap), TTaskControlBlock_t, node);
-            if (timer->expire_time <= current_time) {
-                timer->callback(timer);  
-                reschedule_timer(&timer_heap, timer, current_time);
-            } else {
-                break;
-            }
-        }
+    // 3. 主循环：阻塞在 epoll 上，PIR 有电平变化时才被唤醒
+    TEventLoop_t loop;
+    if (event_loop_init(&loop, &sched) < 0) {
+        perror("event_loop_init");
+        close(g_pir_fd);
+        return EXIT_FAILURE;
+    }
+    if (event_loop_dump_stats_on_signal(&loop, SIGUSR1, getenv("SCHED_STATS_FILE")) < 0)
+        perror("event_loop_dump_stats_on_signal");
+
+    TEventWatcher_t pir_watcher;
+    memset(&pir_watcher, 0, sizeof(pir_watcher));
+    pir_watcher.fd       = g_pir_fd;
+    pir_watcher.events   = EPOLLIN;
+    pir_watcher.callback = on_pir_readable;
+    if (event_loop_add_fd(&loop, &pir_watcher) < 0) {
+        perror("event_loop_add_fd");
+        event_loop_close(&loop);
+        close(g_pir_fd);
+        return EXIT_FAILURE;
     }
 
-    close(g_led_fd);
+    printf("Waiting for PIR events. Press Ctrl+C to stop.\n");
+    event_loop_run(&loop);
+    event_loop_close(&loop);
+
+    close(g_pir_fd);
     return 0;
 }
 /*************************************************************************
  * 改动历史纪录：
  * Revision 1.0, 2025-08-31, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-16, lium
+ * describe: 任务调度移入 sched_inl.h，可编译选择最小堆或分层时间轮.
+ * Revision 1.2, 2026-10-16, lium
+ * describe: 主循环改为 event_loop_inl.h，阻塞等待下一个到期时刻，不再忙等.
+ * Revision 1.3, 2026-10-16, lium
+ * describe: 时间改用 64 位纳秒，周期任务按 expire += interval 推进，不再累积漂移.
+ * Revision 1.4, 2026-10-16, lium
+ * describe: 打开任务统计，收到 SIGUSR1 时输出迟到时间和回调耗时直方图.
+ * Revision 1.5, 2026-10-17, lium
+ * describe: 不再每 2 秒读一次，PIR fd 加入事件循环，读取驱动记录的电平变化事件；
+ *           保留任务统计和 SIGUSR1 输出.
  *************************************************************************/
\ No newline at end of file
@@ -0,0 +1,124 @@
+﻿/*************************************************************************
+ *
+ *   Copyright (C), 2017-2037, BPG. Co., Ltd.
+ *
+ *   文件名称: main.c
+ *   软件模块: 多路数字输入快照演示
+ *   版 本 号: 1.0
+ *   生成日期: 2026-10-17
+ *   作    者: lium
+ *   功    能: 每个周期一次 read(/dev/gpio_in) 得到所有输入引脚的电平和采样时刻，
+ *             只在电平变化时打印；结束时打印平均每次 read 的耗时。
+ *             引脚由加载驱动时的模块参数指定：insmod chrdev.ko pins=89,90,140
+ *             用法: ./zsf08s [周期 ms] [次数，0 表示一直运行]
+ ************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#define GPIO_IN_DEVICE "/dev/gpio_in"
+
+#define GPIO_IN_MAX_PINS    32
+
+/**与驱动中的定义一致 */
+struct gpio_in_snapshot {
+    unsigned long long timestamp_ns;    // 采样时刻，CLOCK_MONOTONIC
+    unsigned int npins;
+    unsigned int levels;                // 第 i 位为第 i 个引脚的电平
+};
+
+struct gpio_in_pins {
+    unsigned int npins;
+    unsigned int pins[GPIO_IN_MAX_PINS];
+};
+
+#define GPIO_IN_MAGIC           'P'
+#define GPIO_IN_IOCTL_GET_PINS  _IOR(GPIO_IN_MAGIC, 0, struct gpio_in_pins)
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// GPIO 编号转为 "C25" 形式
+static void print_pin(unsigned int gpio) {
+    printf(" %c%u", 'A' + gpio / 32, gpio % 32);
+}
+
+int main(int argc, char *argv[]) {
+    struct gpio_in_snapshot snap;
+    struct gpio_in_pins pins;
+    struct timespec period;
+    unsigned long long total_ns = 0;
+    unsigned long long start;
+    unsigned long count = 0;
+    unsigned long limit = 0;
+    unsigned int last = ~0U;
+    long period_ms = 100;
+    unsigned int i;
+    int fd;
+
+    if (argc > 1)
+        period_ms = strtol(argv[1], NULL, 0);
+    if (argc > 2)
+        limit = strtoul(argv[2], NULL, 0);
+    if (period_ms <= 0) {
+        fprintf(stderr, "usage: %s [period_ms > 0] [count]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    period.tv_sec = period_ms / 1000;
+    period.tv_nsec = (period_ms % 1000) * 1000000L;
+
+    fd = open(GPIO_IN_DEVICE, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        fprintf(stderr, "Failed to open device: %s\n", GPIO_IN_DEVICE);
+        return EXIT_FAILURE;
+    }
+
+    if (ioctl(fd, GPIO_IN_IOCTL_GET_PINS, &pins) < 0) {
+        perror("ioctl GPIO_IN_IOCTL_GET_PINS");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    printf("inputs:");
+    for (i = 0; i < pins.npins; i++)
+        print_pin(pins.pins[i]);
+    printf("\n");
+
+    while (limit == 0 || count < limit) {
+        start = now_ns();
+        if (read(fd, &snap, sizeof(snap)) != sizeof(snap)) {
+            perror("read");
+            break;
+        }
+        total_ns += now_ns() - start;
+        count++;
+
+        if (snap.levels != last) {
+            printf("%llu.%06llu s:", snap.timestamp_ns / 1000000000ULL,
+                   snap.timestamp_ns % 1000000000ULL / 1000ULL);
+            for (i = 0; i < snap.npins; i++)
+                printf(" %u", (snap.levels >> i) & 1);
+            printf("\n");
+            fflush(stdout);
+            last = snap.levels;
+        }
+        nanosleep(&period, NULL);
+    }
+
+    if (count)
+        printf("%lu reads, %.2f us per read\n", count, total_ns / 1000.0 / count);
+    close(fd);
+    return 0;
+}
+/*************************************************************************
+ * 改动历史纪录：
+ * Revision 1.0, 2026-10-17, lium
+ * describe: 初始创建.
+ *************************************************************************/
@@ -12,6 +12,10 @@
  *              1. 数字量信号，热释电传感器(PIR)。有人来产生一个高电平，没有人来是低电平
  *              2. 模拟量信号，ADC传感器
  *              3. 时序信号，DHT11传感器。
+ *              PIR 引脚的上升/下降沿产生中断，中断中记录 {时间戳, 电平} 放入 kfifo，
+ *              read 阻塞(或 O_NONBLOCK)取出事件，支持 poll/epoll。
+ *              /dev/gpio_in：模块参数 pins 指定一组输入引脚，一次 read 返回所有引脚
+ *              电平的快照和时间戳，每个用到的 bank 只读一次 GPIOXPAD。
  ************************************************************************/
 
 #include <linux/module.h>
@@ -21,34 +25,130 @@
 #include <linux/fs.h>           // 文件操作集
 #include <linux/device.h>       // create_device
 #include <linux/gpio.h>         // gpio口相关函数
+#include <linux/interrupt.h>    // request_irq
+#include <linux/kfifo.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/io.h>
+#include <linux/ioctl.h>
+#include <linux/atomic.h>
+#include <linux/moduleparam.h>
 #include <cfg_type.h>
 
-#define BUF_SIZE    1                   // 读取到的PIR信号
-static char g_kerner_buf[BUF_SIZE];
+#include "drv_stats.h"
+#define CREATE_TRACE_POINTS
+#include "pir08_trace.h"
 
 static unsigned int majorDevID = 0;     // 主设备号（动态分配）
 static unsigned int minorDevID = 0;     // 次设备号
 static struct cdev chrdev;
+static struct cdev gpioin_cdev;         // 次设备号 minorDevID + 1，/dev/gpio_in
 static dev_t dev_no;
 
 struct class *pClassPIR;
 struct device *pDevicePIR;
+struct device *pDeviceGpioIn;
 
 #define GPIOC25  (PAD_GPIO_C + 25)
 
-unsigned int pir_arr[1] = {GPIOC25};
+static atomic_t pir_available = ATOMIC_INIT(1);    // /dev/PIR 同一时刻只允许打开一次
+
+/**GPIO 寄存器：bank 之间相隔 0x1000，GPIOXPAD 为引脚的实际电平 */
+#define GPIOA_BASE          0xC001A000UL
+#define GPIO_BANK_STRIDE    0x1000
+#define GPIO_BANK_NUM       5               // GPIOA ~ GPIOE
+#define GPIOXPAD_OFFSET     0x18
+#define GPIO_REG_MAP_SIZE   0x20
+
+#define GPIO_IN_MAX_PINS    32
+
+/**
+ * 输入引脚列表，全局 GPIO 编号(bank * 32 + 引脚号)，例如
+ * insmod chrdev.ko pins=89,90,140      (GPIOC25, GPIOC26, GPIOE12)
+ * PIR 引脚 GPIOC25 总是由本驱动占用，不在列表中时也会单独申请。
+ */
+static int in_pins[GPIO_IN_MAX_PINS] = { GPIOC25 };
+static int in_npins = 1;
+module_param_array_named(pins, in_pins, int, &in_npins, 0444);
+MODULE_PARM_DESC(pins, "input GPIOs for /dev/gpio_in, bank*32+pin, default GPIOC25");
+
+static void __iomem *gpio_bank_va[GPIO_BANK_NUM];  // 用到的 bank 的寄存器，未用到为 NULL
+static int pir_pin_extra;                           // GPIOC25 不在 in_pins 中，单独申请
+
+/**一次快照：第 i 位为 in_pins[i] 的电平 */
+struct gpio_in_snapshot {
+    unsigned long long timestamp_ns;    // 采样时刻，CLOCK_MONOTONIC
+    unsigned int npins;
+    unsigned int levels;
+};
+
+/**快照中各位对应的 GPIO 编号 */
+struct gpio_in_pins {
+    unsigned int npins;
+    unsigned int pins[GPIO_IN_MAX_PINS];
+};
+
+#define GPIO_IN_MAGIC           'P'
+#define GPIO_IN_IOCTL_GET_PINS  _IOR(GPIO_IN_MAGIC, 0, struct gpio_in_pins)
+
+/**
+ * 一次电平变化。read 每次返回整数个事件，count 小于一个事件时返回 -EINVAL。
+ * 打开设备时先放入一个当前电平的事件，之后每个边沿一个。
+ */
+struct pir_event {
+    unsigned long long timestamp_ns;    // 中断发生时刻，CLOCK_MONOTONIC
+    unsigned int level;                 // 边沿之后的电平，1 有人 0 无人
+    unsigned int dropped;               // 此事件之前因队列满而丢弃的事件数
+};
+
+#define PIR_FIFO_SIZE   64              // 事件队列容量，须为 2 的幂
+
+static DECLARE_KFIFO(pir_fifo, struct pir_event, PIR_FIFO_SIZE);
+static DECLARE_WAIT_QUEUE_HEAD(pir_waitq);
+static DEFINE_MUTEX(pir_read_lock);     // kfifo 只允许一个读者，多个 read 之间串行
+static int pir_irq = -1;
+static unsigned int pir_dropped;        // 只在中断中修改
+
+/**debugfs 计数器：/sys/kernel/debug/pir08/stats */
+enum {
+    PIR_STAT_IRQS = 0,
+    PIR_STAT_READS,
+    PIR_STAT_DROPPED,
+    PIR_STAT_SNAPSHOTS,
+    PIR_STAT_ERRORS,
+    PIR_STAT_NUM
+};
+static const char *const pir_stat_names[PIR_STAT_NUM] = { "irqs", "reads", "dropped", "snapshots", "errors" };
+static struct drv_stats pir_stats;
 
 static int pir_open(struct inode *inode, struct file *pFile);
 static int pir_close(struct inode *inode, struct file *pFile);
 static ssize_t pir_read(struct file *filp, char __user *pBuff, size_t count, loff_t *ppos);
+static unsigned int pir_poll(struct file *filp, struct poll_table_struct *wait);
 
 static const struct file_operations PIR_fops = {
     .owner      = THIS_MODULE,
     .open       = pir_open,
     .release    = pir_close,
     .read      = pir_read,
+    .poll       = pir_poll,
+};
+
+static ssize_t gpio_in_read(struct file *filp, char __user *pBuff, size_t count, loff_t *ppos);
+static long gpio_in_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+
+static const struct file_operations gpio_in_fops = {
+    .owner          = THIS_MODULE,
+    .open           = nonseekable_open,
+    .read           = gpio_in_read,
+    .unlocked_ioctl = gpio_in_ioctl,
 };
 
+static int gpio_in_setup(void);
+static void gpio_in_release(void);
+
 static int __init chrDevInit(void)
 {
     int ret;
@@ -56,9 +156,9 @@ static int __init chrDevInit(void)
     /**1. 申请设备号(推荐使用动态注册) */
     if (majorDevID) {
         dev_no = MKDEV(majorDevID, minorDevID);
-        ret = register_chrdev_region(dev_no, 1, "Sensor_Device");
+        ret = register_chrdev_region(dev_no, 2, "Sensor_Device");
     } else {
-        ret = alloc_chrdev_region(&dev_no, minorDevID, 1, "Sensor_Device");
+        ret = alloc_chrdev_region(&dev_no, minorDevID, 2, "Sensor_Device");
         majorDevID = MAJOR(dev_no);
     }
     if (ret < 0) {
@@ -66,9 +166,18 @@ static int __init chrDevInit(void)
         return ret;
     }
 
+    INIT_KFIFO(pir_fifo);
+
+    /**申请输入引脚并映射用到的 bank */
+    ret = gpio_in_setup();
+    if (ret < 0)
+        goto err_gpio_in;
+
     /**2. 字符设备初始化 */
     cdev_init(&chrdev, &PIR_fops);
     chrdev.owner = THIS_MODULE;
+    cdev_init(&gpioin_cdev, &gpio_in_fops);
+    gpioin_cdev.owner = THIS_MODULE;
 
     /**3. 将cdev注册到linux内核。执行成功可以通过 cat /proc/devices  查看字符设备"Sensor_Device" */
     ret = cdev_add(&chrdev, dev_no, 1);
@@ -76,6 +185,11 @@ static int __init chrDevInit(void)
         printk(KERN_ERR "cdev_add failed\n");
         goto err_cdev_add;
     }
+    ret = cdev_add(&gpioin_cdev, dev_no + 1, 1);
+    if (ret < 0) {
+        printk(KERN_ERR "cdev_add failed\n");
+        goto err_cdev_add_gpioin;
+    }
 
     /**4. 在 /sys/class/ 下创建设备类 */
     pClassPIR = class_create(THIS_MODULE, "PIR_class");
@@ -94,104 +208,345 @@ static int __init chrDevInit(void)
         pDevicePIR = NULL;
         goto err_device_create;
     }
+    pDeviceGpioIn = device_create(pClassPIR, NULL, dev_no + 1, NULL, "gpio_in");
+    if (IS_ERR_OR_NULL(pDeviceGpioIn)) {
+        printk(KERN_ERR "device_create failed\n");
+        ret = PTR_ERR(pDeviceGpioIn);
+        pDeviceGpioIn = NULL;
+        goto err_device_create_gpioin;
+    }
 
+    drv_stats_init(&pir_stats, "pir08", pir_stat_names, PIR_STAT_NUM);
     printk(KERN_INFO "PIR driver initialized successfully (major=%d)\n", majorDevID);
     return 0;
 
 /**错误处理：反向释放资源 */
+err_device_create_gpioin:
+    device_destroy(pClassPIR, dev_no);
 err_device_create:
     class_destroy(pClassPIR);
 err_class_create:
+    cdev_del(&gpioin_cdev);
+err_cdev_add_gpioin:
     cdev_del(&chrdev);
 err_cdev_add:
-    unregister_chrdev_region(dev_no, 1);
+    gpio_in_release();
+err_gpio_in:
+    unregister_chrdev_region(dev_no, 2);
     return ret;
 }
 
 static void __exit chrDevExit(void)
 {
+    drv_stats_exit(&pir_stats);
+
+    if (pDeviceGpioIn)
+        device_destroy(pClassPIR, dev_no + 1);
+
     if (pDevicePIR)
-        device_destroy(pDevicePIR, dev_no);
+        device_destroy(pClassPIR, dev_no);
 
     if (pClassPIR)
         class_destroy(pClassPIR);
 
+    cdev_del(&gpioin_cdev);
     cdev_del(&chrdev);
 
-    unregister_chrdev_region(dev_no, 1);
+    gpio_in_release();
+
+    unregister_chrdev_region(dev_no, 2);
 
     printk(KERN_INFO "chrDevExit: PIR driver unloaded\n");
 }
 
-static int pir_open(struct inode *inode, struct file *pFile)
+/**
+ * @brief 把一个事件放入队列并唤醒读者，只在中断(或中断关闭前的 open)中调用，
+ *        kfifo 单生产者单消费者无需加锁
+ */
+static void pir_push_event(int level)
+{
+    struct pir_event ev;
+
+    ev.timestamp_ns = ktime_to_ns(ktime_get());
+    ev.level = level;
+    ev.dropped = pir_dropped;
+
+    if (kfifo_in(&pir_fifo, &ev, 1) == 0) {
+        // 队列满：丢弃新事件，计入下一次成功入队的事件
+        pir_dropped++;
+        drv_stats_inc(&pir_stats, PIR_STAT_DROPPED);
+        return;
+    }
+    pir_dropped = 0;
+    wake_up_interruptible(&pir_waitq);
+}
+
+/**
+ * @brief 上升沿和下降沿都会进入，读取边沿之后的电平
+ */
+static irqreturn_t pir_irq_handler(int irq, void *dev_id)
 {
-    int ret, i;
-    for(i = 0; i < 1; i++){
-        /**申请GPIO口来使用 */
-        ret = gpio_request(pir_arr[i], "PIRIndex");
-        if(ret < 0){
+    int level = !!gpio_get_value(GPIOC25);
+
+    drv_stats_inc(&pir_stats, PIR_STAT_IRQS);
+    trace_pir08_irq("PIR", GPIOC25, level);
+    pir_push_event(level);
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief 申请 in_pins 中的引脚(及 GPIOC25)设为输入，并映射它们所在的 bank
+ */
+static int gpio_in_setup(void)
+{
+    unsigned int bank;
+    int ret = 0;
+    int i;
+
+    if (in_npins < 1 || in_npins > GPIO_IN_MAX_PINS)
+        return -EINVAL;
+
+    pir_pin_extra = 1;
+    for (i = 0; i < in_npins; i++) {
+        if (in_pins[i] < 0 || in_pins[i] >= GPIO_BANK_NUM * 32) {
+            printk(KERN_ERR "pins[%d] = %d out of range\n", i, in_pins[i]);
+            ret = -EINVAL;
+            goto err;
+        }
+        if (in_pins[i] == GPIOC25)
+            pir_pin_extra = 0;
+    }
+
+    /**1. 申请GPIO口，设置为输入模式 */
+    for (i = 0; i < in_npins; i++) {
+        ret = gpio_request(in_pins[i], "SensorInput");
+        if (ret < 0) {
+            printk(KERN_ERR "gpio_request %d failed! \n", in_pins[i]);
+            goto err_request;
+        }
+        gpio_direction_input(in_pins[i]);
+    }
+    if (pir_pin_extra) {
+        ret = gpio_request(GPIOC25, "PIRIndex");
+        if (ret < 0) {
             printk(KERN_ERR "gpio_request failed! \n");
-            return ret;
+            goto err_request;
         }
+        gpio_direction_input(GPIOC25);
+    }
 
-        /**GPIO口设置为输入模式 */
-        gpio_direction_input(pir_arr[i]);
+    /**2. 每个用到的 bank 映射一次，寄存器区域已由 GPIO 驱动申请，这里只做 ioremap */
+    for (i = 0; i < in_npins; i++) {
+        bank = in_pins[i] / 32;
+        if (gpio_bank_va[bank])
+            continue;
+        gpio_bank_va[bank] = ioremap(GPIOA_BASE + bank * GPIO_BANK_STRIDE, GPIO_REG_MAP_SIZE);
+        if (!gpio_bank_va[bank]) {
+            printk(KERN_ERR "ioremap GPIO bank %c failed\n", 'A' + bank);
+            ret = -ENOMEM;
+            i = in_npins;
+            goto err_ioremap;
+        }
     }
-    printk(KERN_INFO "pir_open success! \n");
+    return 0;
+
+err_ioremap:
+    for (bank = 0; bank < GPIO_BANK_NUM; bank++) {
+        if (gpio_bank_va[bank])
+            iounmap(gpio_bank_va[bank]);
+        gpio_bank_va[bank] = NULL;
+    }
+    if (pir_pin_extra)
+        gpio_free(GPIOC25);
+err_request:
+    while (--i >= 0)
+        gpio_free(in_pins[i]);
+err:
     return ret;
 }
 
-static int pir_close(struct inode *inode, struct file *pFile)
+static void gpio_in_release(void)
 {
+    unsigned int bank;
     int i;
 
-    /**释放GPIO */
-    for(i = 0; i < 1; i++){
-        gpio_free(pir_arr[i]);
+    for (bank = 0; bank < GPIO_BANK_NUM; bank++) {
+        if (gpio_bank_va[bank])
+            iounmap(gpio_bank_va[bank]);
+        gpio_bank_va[bank] = NULL;
+    }
+    for (i = 0; i < in_npins; i++)
+        gpio_free(in_pins[i]);
+    if (pir_pin_extra)
+        gpio_free(GPIOC25);
+}
+
+static int pir_open(struct inode *inode, struct file *pFile)
+{
+    int ret;
+
+    /**中断和事件队列只有一份，同一时刻只允许一个进程打开 */
+    if (!atomic_dec_and_test(&pir_available)) {
+        atomic_inc(&pir_available);
+        return -EBUSY;
     }
+
+    /**先放入当前电平，再打开中断 */
+    kfifo_reset(&pir_fifo);
+    pir_dropped = 0;
+    pir_push_event(!!gpio_get_value(GPIOC25));
+
+    /**双边沿中断 */
+    pir_irq = gpio_to_irq(GPIOC25);
+    ret = request_irq(pir_irq, pir_irq_handler,
+                      IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING, "PIR", NULL);
+    if (ret < 0) {
+        printk(KERN_ERR "request_irq %d failed! \n", pir_irq);
+        pir_irq = -1;
+        atomic_inc(&pir_available);
+        return ret;
+    }
+
+    printk(KERN_INFO "pir_open success! \n");
+    return 0;
+}
+
+static int pir_close(struct inode *inode, struct file *pFile)
+{
+    if (pir_irq >= 0) {
+        free_irq(pir_irq, NULL);
+        pir_irq = -1;
+    }
+    atomic_inc(&pir_available);
     printk(KERN_INFO "PIR_close success! \n");
     return 0;
 }
 
 /**
- * @brief 读取热释电传感器的数据；
- * @param buf[0] 表示控制哪一盏灯
- * @param buf[1] 表示亮还什么灭
+ * @brief 读取电平变化事件
+ * @param count 至少为 sizeof(struct pir_event)，一次最多取出 count / sizeof(struct pir_event) 个
+ * @return 读到的字节数；队列为空时阻塞，O_NONBLOCK 时返回 -EAGAIN
  */
 static ssize_t pir_read(struct file *filp, char __user *pBuff, size_t count, loff_t *ppos)
 {
-    int gpio_val;
+    unsigned int copied;
+    int ret;
 
-    if(count > BUF_SIZE){
-       count = BUF_SIZE;    // 只能读取一个字节
+    if (count < sizeof(struct pir_event))
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&pir_read_lock))
+        return -ERESTARTSYS;
+
+    while (kfifo_is_empty(&pir_fifo)) {
+        mutex_unlock(&pir_read_lock);
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(pir_waitq, !kfifo_is_empty(&pir_fifo)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&pir_read_lock))
+            return -ERESTARTSYS;
     }
 
-    if (count == 0){
-        return 0;
+    ret = kfifo_to_user(&pir_fifo, pBuff, count, &copied);
+    mutex_unlock(&pir_read_lock);
+
+    if (ret != 0) {
+        drv_stats_inc(&pir_stats, PIR_STAT_ERRORS);
+        pr_debug("pir_read: kfifo_to_user failed\n");
+        return ret;
     }
+    drv_stats_inc(&pir_stats, PIR_STAT_READS);
+    trace_pir08_read("PIR", GPIOC25, copied / sizeof(struct pir_event));
+    return copied;
+}
+
+/**
+ * @brief 队列中有事件时可读
+ */
+static unsigned int pir_poll(struct file *filp, struct poll_table_struct *wait)
+{
+    poll_wait(filp, &pir_waitq, wait);
+    return kfifo_is_empty(&pir_fifo) ? 0 : (POLLIN | POLLRDNORM);
+}
 
-    /**读取GPIO口的电平 */ 
-    gpio_val = gpio_get_value(GPIOC25);
-    g_kerner_buf[0] = gpio_val + '0';    // 转为字符 '0' 或 '1'
+/**
+ * @brief 读取所有输入引脚的快照，不阻塞，每次 read 都重新采样
+ * @param count 至少为 sizeof(struct gpio_in_snapshot)
+ */
+static ssize_t gpio_in_read(struct file *filp, char __user *pBuff, size_t count, loff_t *ppos)
+{
+    struct gpio_in_snapshot snap;
+    unsigned int pad[GPIO_BANK_NUM] = { 0 };
+    unsigned int bank;
+    int i;
 
-    /**将读取到的数据传递给用户空将 */
-    if(copy_to_user(pBuff, g_kerner_buf, count)){
-        printk(KERN_ERR "copy_to_user failed! \n");
+    if (count < sizeof(snap))
+        return -EINVAL;
+
+    /**每个 bank 一次 MMIO 读 */
+    snap.timestamp_ns = ktime_to_ns(ktime_get());
+    for (bank = 0; bank < GPIO_BANK_NUM; bank++) {
+        if (gpio_bank_va[bank])
+            pad[bank] = ioread32(gpio_bank_va[bank] + GPIOXPAD_OFFSET);
+    }
+
+    snap.npins = in_npins;
+    snap.levels = 0;
+    for (i = 0; i < in_npins; i++) {
+        if (pad[in_pins[i] / 32] & (1U << (in_pins[i] % 32)))
+            snap.levels |= 1U << i;
+    }
+
+    if (copy_to_user(pBuff, &snap, sizeof(snap))) {
+        drv_stats_inc(&pir_stats, PIR_STAT_ERRORS);
         return -EFAULT;
     }
-    printk(KERN_INFO "kernel layer pir_read: read value '%c'\n", g_kerner_buf[0]);
-    return count;  // 返回实际读取的字节数
+    drv_stats_inc(&pir_stats, PIR_STAT_SNAPSHOTS);
+    trace_pir08_snapshot("gpio_in", -1, snap.levels);
+    return sizeof(snap);
+}
+
+/**
+ * @brief GPIO_IN_IOCTL_GET_PINS 查询快照中各位对应的 GPIO 编号
+ */
+static long gpio_in_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    struct gpio_in_pins info;
+    int i;
+
+    switch (cmd) {
+        case GPIO_IN_IOCTL_GET_PINS:
+            memset(&info, 0, sizeof(info));
+            info.npins = in_npins;
+            for (i = 0; i < in_npins; i++)
+                info.pins[i] = in_pins[i];
+            if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+                return -EFAULT;
+            return 0;
+        default:
+            return -ENOTTY;
+    }
 }
 
 module_init(chrDevInit);
 module_exit(chrDevExit);
 
 MODULE_AUTHOR("lium <123456@qq.com>");
-MODULE_DESCRIPTION("PIR Control Driver using GPIOC[25]");
+MODULE_DESCRIPTION("PIR Control Driver using GPIOC[25], with multi-pin input snapshots");
 MODULE_LICENSE("GPL");
 MODULE_VERSION("2025-09-08_V1.1");
 /*************************************************************************
  * 改动历史纪录：
  * Revision 1.0, 2025-08-31, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 读路径上的 printk 改为 pir08_read 跟踪点，
+ *           增加 debugfs 计数器 /sys/kernel/debug/pir08/stats.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 改为双边沿中断，{时间戳, 电平} 事件放入 kfifo，read 阻塞/O_NONBLOCK，
+ *           新增 poll；修正卸载时 device_destroy 传入设备而不是类的问题.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 新增 /dev/gpio_in，模块参数 pins 配置输入引脚，一次 read 返回所有引脚的
+ *           二进制快照；引脚改为加载模块时申请.
  *************************************************************************/
\ No newline at end of file
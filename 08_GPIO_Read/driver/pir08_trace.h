@@ -0,0 +1,73 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: pir08_trace.h
+ *   软件模块: 跟踪点
+ *   功    能: 人体红外传感器驱动的 tracepoint，字段统一为 dev/pin/value/ts，
+ *             ts 为 CLOCK_MONOTONIC 纳秒，可直接与应用层的时间对齐。
+ *             默认关闭，几乎没有开销；需要时：
+ *             echo 1 > /sys/kernel/debug/tracing/events/pir08/enable
+ *             cat /sys/kernel/debug/tracing/trace_pipe
+ *             或 perf record -e 'pir08:*'
+ *
+ ************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pir08
+
+#if !defined(PIR08_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define PIR08_TRACE_H_
+
+#include <linux/tracepoint.h>
+#include <linux/ktime.h>
+
+/**
+ * dev   设备名
+ * pin   GPIO 编号，bank*32+bit；快照事件为 -1
+ * value irq 事件为边沿之后的电平，0 低 1 高；read 事件为取出的事件个数；
+ *       快照事件为各引脚电平的位图
+ */
+DECLARE_EVENT_CLASS(pir08_pin_class,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value),
+    TP_STRUCT__entry(
+        __string(dev, dev)
+        __field(int, pin)
+        __field(int, value)
+        __field(u64, ts)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev);
+        __entry->pin = pin;
+        __entry->value = value;
+        __entry->ts = ktime_to_ns(ktime_get());
+    ),
+    TP_printk("dev=%s pin=%d value=%d ts=%llu",
+              __get_str(dev), __entry->pin, __entry->value,
+              (unsigned long long)__entry->ts)
+);
+
+/**每个边沿中断一个事件 */
+DEFINE_EVENT(pir08_pin_class, pir08_irq,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+/**每次 read 返回一个事件 */
+DEFINE_EVENT(pir08_pin_class, pir08_read,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+/**每次 /dev/gpio_in 快照一个事件 */
+DEFINE_EVENT(pir08_pin_class, pir08_snapshot,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+#endif  /* PIR08_TRACE_H_ */
+
+/* 跟踪头文件在驱动目录下，Makefile 中需要 CFLAGS_xxx.o := -I$(src) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pir08_trace
+#include <trace/define_trace.h>
@@ -7,37 +7,71 @@
  *   版 本 号: 1.0
  *   生成日期: 2025-09-08
  *   作    者: lium
- *   功    能:  每2s钟读取DHT11的数据
+ *   功    能:  等待驱动后台采样的每一个新结果并打印，不再自己定时触发传输
  ************************************************************************/
 
 #include <stdio.h>
 #include <fcntl.h>          // O_RDWR
 #include <unistd.h>         // close
+#include <time.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <string.h>
 
 #define GET_DHT11_DATA _IOR('w', 0, unsigned long)
 
+/**与驱动中的定义一致 */
+struct dht11_record {
+    unsigned long long timestamp_ns;    // 最近一次成功采样的时刻，0 表示还没有成功过
+    int status;                         // 最近一次采样的结果，0 成功，否则为负的错误码
+    unsigned int seq;                   // 采样次数(含失败)
+    unsigned char temp_int;
+    unsigned char temp_dec;
+    unsigned char hum_int;
+    unsigned char hum_dec;
+};
+
+#define DHT11_IOCTL_GET_RECORD      _IOR('w', 1, struct dht11_record)
+#define DHT11_IOCTL_WAIT_FRESH      _IOR('w', 2, struct dht11_record)
+#define DHT11_IOCTL_SET_INTERVAL    _IOW('w', 3, unsigned int)
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 int main(int argc, char **argv)
 {
-    int ret;
-    unsigned char buff[4] = {0};
+    struct dht11_record rec;
+    unsigned int interval_ms = 2000;
     int fd = open("/dev/dht11", O_RDWR);
     if(fd < 0){
         perror("open dht11_dev driver");
         return -1;
     }
 
+    // 采样周期由驱动控制，所有打开设备的进程共用
+    if (ioctl(fd, DHT11_IOCTL_SET_INTERVAL, &interval_ms) != 0)
+        perror("DHT11_IOCTL_SET_INTERVAL");
+
     while(1){
-        printf("检测中\n");
-        ret  = ioctl(fd, GET_DHT11_DATA, buff);
-        if (ret != 0) {
-            perror("GET_DHT11_DATA error");
-        } else {
-            printf("温度 = %hhu.%hhu, 湿度 = %hhu.%hhu  \n", buff[0], buff[1], buff[2], buff[3]);
+        // 阻塞到驱动完成下一次采样
+        if (ioctl(fd, DHT11_IOCTL_WAIT_FRESH, &rec) != 0) {
+            if (errno == EINTR)
+                continue;
+            perror("DHT11_IOCTL_WAIT_FRESH error");
+            break;
         }
 
-        sleep(2);
+        if (rec.status != 0)
+            printf("[%u] 采样失败: %s\n", rec.seq, strerror(-rec.status));
+        if (rec.timestamp_ns != 0)
+            printf("[%u] 温度 = %hhu.%hhu, 湿度 = %hhu.%hhu (%llu ms 前)\n", rec.seq,
+                   rec.temp_int, rec.temp_dec, rec.hum_int, rec.hum_dec,
+                   (now_ns() - rec.timestamp_ns) / 1000000ULL);
+        fflush(stdout);
     }
     close(fd);
     return 0;
@@ -48,4 +82,6 @@ int main(int argc, char **argv)
  * 改动历史纪录：
  * Revision 1.0, 2025-09-20, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 改为 DHT11_IOCTL_WAIT_FRESH 等待驱动后台采样的结果.
  *************************************************************************/
\ No newline at end of file
@@ -8,6 +8,11 @@
  *   生成日期: 2025-09-20
  *   作    者: lium
  *   功    能: 通过GPIO口读取DHT11
+ *              起始信号的 20ms 低电平由 hrtimer 结束，不占用 CPU；DHT11 应答和
+ *              40 位数据在双边沿中断中只记录时间戳，传输结束后再按高电平宽度解码，
+ *              整个过程不关中断，也不忙等。
+ *              设备打开期间由 delayed work 按 interval_ms 周期采样，结果缓存在
+ *              驱动中，ioctl 直接返回缓存，多个进程读取不会增加传输次数。
  *
  ************************************************************************/
 #include <linux/module.h>
@@ -18,7 +23,18 @@
 #include <linux/device.h>       // create_device
 #include <linux/gpio.h>         // gpio口相关函数
 #include <cfg_type.h>           // 端口宏定义
-#include <linux/delay.h>        // 延时函数
+#include <linux/interrupt.h>    // request_irq
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/moduleparam.h>
+#include <linux/delay.h>        // usleep_range
+
+#include "dht11_decode.h"       // 解码与硬件无关，主机上的测试程序共用
 
 static unsigned int majorDevID = 0;     // 主设备号（动态分配）
 static unsigned int minorDevID = 0;     // 次设备号
@@ -29,12 +45,66 @@ struct device *pDevice;
 
 #define DHT11_DATA (PAD_GPIO_B + 29)
 
-#define GET_DHT11_DATA _IOR('w', 0, unsigned long)
+#define GET_DHT11_DATA _IOR('w', 0, unsigned long)      // 最近一次成功的温湿度(4 字节，温度在前)
+
+/**缓存的采样记录 */
+struct dht11_record {
+    unsigned long long timestamp_ns;    // 最近一次成功采样的时刻，CLOCK_MONOTONIC，0 表示还没有成功过
+    int status;                         // 最近一次采样的结果，0 成功，否则为负的错误码
+    unsigned int seq;                   // 采样次数(含失败)，每完成一次加 1
+    unsigned char temp_int;             // 以下为最近一次成功采样的值
+    unsigned char temp_dec;
+    unsigned char hum_int;
+    unsigned char hum_dec;
+};
+
+#define DHT11_IOCTL_GET_RECORD      _IOR('w', 1, struct dht11_record)   // 立即返回缓存
+#define DHT11_IOCTL_WAIT_FRESH      _IOR('w', 2, struct dht11_record)   // 阻塞到下一次采样完成
+#define DHT11_IOCTL_SET_INTERVAL    _IOW('w', 3, unsigned int)          // 采样周期(ms)
+
+#define DHT11_MIN_INTERVAL_MS   1000    // DHT11 两次采样至少间隔 1s
+
+static unsigned int interval_ms = 2000;
+module_param(interval_ms, uint, 0644);
+MODULE_PARM_DESC(interval_ms, "sampling interval in ms while the device is open (>= 1000)");
+
+/**时序参数，位宽阈值等解码参数见 dht11_decode.h */
+#define DHT11_START_MS          20      // 起始信号：主机拉低至少 18ms
+#define DHT11_XFER_MS           10      // 释放总线后应答 + 40 位数据最长约 5ms，留余量
+
+/**
+ * 释放总线后的边沿：应答 3 个(下降、上升、下降) + 每位 2 个 + 结束 1 个 = 84，
+ * 若释放总线时的上升沿也被记录则为 85，记满 84 个时 40 位已全部完整。
+ * 有毛刺时会多出边沿，记满 84 个时可能还差几位，继续记录 DHT11_TAIL_US 再解码。
+ */
+#define DHT11_DONE_EDGES        84
+#define DHT11_MAX_EDGES         96
+#define DHT11_TAIL_US           1000    // 最多 6 个毛刺 = 6 位，每位最长约 120us
+
+static DEFINE_MUTEX(dht11_mutex);       // 一次只进行一个传输
+static DEFINE_SPINLOCK(dht11_lock);     // 保护下面的采集状态，中断与进程上下文共用
+static struct hrtimer dht11_start_timer;
+static DECLARE_COMPLETION(dht11_done);
+static int dht11_irq = -1;
+static int dht11_capturing;             // 为 1 时中断记录边沿
+static int dht11_nedges;
+static long long dht11_edge_ns[DHT11_MAX_EDGES];    // 边沿时刻(ns)
+static unsigned char dht11_edge_level[DHT11_MAX_EDGES];  // 边沿之后的电平
+
+/**后台采样 */
+static struct delayed_work dht11_sample_work;
+static DEFINE_MUTEX(dht11_users_mutex); // 保护 dht11_users，串行化开始/停止采样
+static int dht11_users;                 // 打开设备的次数，大于 0 时周期采样
+static DEFINE_SPINLOCK(dht11_rec_lock); // 保护 dht11_rec
+static struct dht11_record dht11_rec;
+static DECLARE_WAIT_QUEUE_HEAD(dht11_waitq);   // 每次采样完成时唤醒
 
 static int dht11_open(struct inode *inode, struct file *pFile);
 static int dht11_close(struct inode *inode, struct file *pFile);
 static long dht11_ioctl(struct file *pFile, unsigned int cmd, unsigned long arg);
-static unsigned char get_value(void);
+static enum hrtimer_restart dht11_start_timer_fn(struct hrtimer *timer);
+static irqreturn_t dht11_edge_irq(int irq, void *dev_id);
+static void dht11_sample_fn(struct work_struct *work);
 
 static const struct file_operations dht11_fops = {
     .owner      = THIS_MODULE,
@@ -102,6 +172,21 @@ static int __init chrDevInit(void)
         goto err_gpio;
     }
 
+    /**8.双边沿中断，只在采集期间记录 */
+    INIT_DELAYED_WORK(&dht11_sample_work, dht11_sample_fn);
+    hrtimer_init(&dht11_start_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    dht11_start_timer.function = dht11_start_timer_fn;
+
+    dht11_irq = gpio_to_irq(DHT11_DATA);
+    ret = request_irq(dht11_irq, dht11_edge_irq,
+                      IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING, "dht11", NULL);
+    if (ret != 0) {
+        printk(KERN_ERR "request_irq %d failed\n", dht11_irq);
+        dht11_irq = -1;
+        gpio_free(DHT11_DATA);
+        goto err_gpio;
+    }
+
     printk(KERN_INFO "dht11 driver initialized successfully (major=%d)\n", majorDevID);
     return 0;
 
@@ -119,6 +204,10 @@ err_cdev_add:
 
 static void __exit chrDevExit(void)
 {
+    cancel_delayed_work_sync(&dht11_sample_work);
+    hrtimer_cancel(&dht11_start_timer);
+    if (dht11_irq >= 0)
+        free_irq(dht11_irq, NULL);
     gpio_free(DHT11_DATA);
 
     if (pDevice)
@@ -134,172 +223,233 @@ static void __exit chrDevExit(void)
     printk(KERN_INFO "chrDevExit: dht11 driver unloaded\n");
 }
 
+/**
+ * @brief 第一个进程打开时立即开始采样，之后每 interval_ms 采样一次
+ */
 static int dht11_open(struct inode *inode, struct file *pFile)
 {
-    /**打开时钟 */
-
-    /**配置GPIO口 */
-
-    gpio_set_value(DHT11_DATA, 1);
-
-    /**使能GPIO */
+    mutex_lock(&dht11_users_mutex);
+    if (dht11_users++ == 0)
+        schedule_delayed_work(&dht11_sample_work, 0);
+    mutex_unlock(&dht11_users_mutex);
 
     printk(KERN_INFO "dht11_open open success\n");
     return 0;
 }
 
+/**
+ * @brief 最后一个进程关闭时停止采样，缓存保留到下次打开
+ */
 static int dht11_close(struct inode *inode, struct file *pFile)
 {
-    gpio_set_value(DHT11_DATA, 1);
+    mutex_lock(&dht11_users_mutex);
+    if (--dht11_users == 0)
+        cancel_delayed_work_sync(&dht11_sample_work);
+    mutex_unlock(&dht11_users_mutex);
+
     printk(KERN_INFO "dht11_open close success\n");
     return 0;
 }
 
-static long dht11_ioctl(struct file *pFile, unsigned int cmd, unsigned long arg)
+/**
+ * @brief 起始信号结束(中断上下文)：开始记录边沿，然后释放总线，上拉电阻拉高后 DHT11 应答
+ */
+static enum hrtimer_restart dht11_start_timer_fn(struct hrtimer *timer)
 {
-    int ret;
-    int i;
-    int timeout;                            // 超时时间
-    unsigned long flags;                    // 保存中断值
-    unsigned char dht11Arr[5] = {0};        // 数组    
-    unsigned char check_sum = 0;             // 校验和
-
-    if(cmd == GET_DHT11_DATA){
-        // 关闭中断(我在采集DHT11的数据的期间，不希望CPU打断执行)
-        local_irq_save(flags);
-
-        // 设置为输出模式
-        ret = gpio_direction_output(DHT11_DATA, 0);
-        if(ret != 0){
-            printk(KERN_ERR "gpio_direction_output failed\n");
-        }
-
-        // 步骤2：发送起始信号。主机拉低18ms信号
-        gpio_set_value(DHT11_DATA, 0);
-        msleep(20);
-
-        // 设置为输入模型
-        ret = gpio_direction_input(DHT11_DATA);
-        if(ret != 0){
-            printk(KERN_ERR "gpio_direction_input failed\n");
-            local_irq_restore(flags);
-            return ret;
-        }
-        
-        // 设置为输入之后，延时10us在去读取引脚电平。
-        udelay(10);
-        // 如果10us都过去了，引脚还是没有响应(响应低电平)。那就判断为DHT11不鸟MCU
-        if(gpio_get_value(DHT11_DATA)){
-            printk(KERN_ERR "DHT11 timeout error\n");
-            local_irq_restore(flags);
-            return -1;
-        }
-
-        // 步骤3：DHT11响应信号判断
-        timeout = 0;
-        while(!gpio_get_value(DHT11_DATA))
-        {
-            timeout++;
-            udelay(1);
-            if(timeout > 160){
-                printk(KERN_ERR "DHT11 timeout error\n");
-                local_irq_restore(flags);
-                return -1;
-            }
-        }
-
-        timeout = 0;
-        while(gpio_get_value(DHT11_DATA))
-        {
-            timeout++;
-            udelay(1);
-            if(timeout > 160){
-                printk(KERN_ERR "DHT11 timeout error\n");
-                local_irq_restore(flags);
-                return -1;
-            }
-        }
-
-        // 步骤4：获取DHT11数据
-        for(i = 0; i < 5; i++){
-            dht11Arr[i] = get_value();
-        }
-
-        /* 判断效验和 */
-        check_sum = (dht11Arr[0] + dht11Arr[1] + dht11Arr[2] + dht11Arr[3]) & 0xFF;
-        if(check_sum != dht11Arr[4]){
-            printk(KERN_ERR "DHT11 check_sum error\n");
-            return -1;
-        }
-        local_irq_restore(flags);
-    } else {
-        printk(KERN_INFO "ioctl cmd error\n");
-        return -1;
-    }
+    unsigned long flags;
 
-    // 仅仅打印湿度和温度的整数部分
-    printk(KERN_INFO "th_data = %hhu temp_data = %hhu\n", dht11Arr[0], dht11Arr[2]);
+    spin_lock_irqsave(&dht11_lock, flags);
+    dht11_nedges = 0;
+    dht11_capturing = 1;
+    spin_unlock_irqrestore(&dht11_lock, flags);
 
-    // 将湿度传递到用户空间
-    ret = copy_to_user(((unsigned char *)arg) + 2, &dht11Arr[0], 2);
-    if(ret != 0){
-        printk(KERN_ERR "copy_to_user failed\n");
-        return -1;
+    gpio_direction_input(DHT11_DATA);
+    return HRTIMER_NORESTART;
+}
+
+/**
+ * @brief 边沿中断：只记录时刻和电平，不做任何判断
+ */
+static irqreturn_t dht11_edge_irq(int irq, void *dev_id)
+{
+    s64 now = ktime_to_ns(ktime_get());
+    int level = gpio_get_value(DHT11_DATA);
+
+    spin_lock(&dht11_lock);
+    if (dht11_capturing && dht11_nedges < DHT11_MAX_EDGES) {
+        dht11_edge_ns[dht11_nedges] = now;
+        dht11_edge_level[dht11_nedges] = !!level;
+        if (++dht11_nedges == DHT11_DONE_EDGES)
+            complete(&dht11_done);      // 不停止记录，毛刺多出的边沿之后的位还要用
     }
+    spin_unlock(&dht11_lock);
+    return IRQ_HANDLED;
+}
 
-    // 将温度传递到用户空间
-    ret = copy_to_user(((unsigned char *)arg) + 0, &dht11Arr[2], 2);
-    if(ret != 0){
-        printk(KERN_ERR "copy_to_user failed\n");
-        return -1;
+/**
+ * @brief 进行一次完整的传输，进程上下文，约 25ms，期间睡眠
+ */
+static int dht11_transfer(unsigned char data[5])
+{
+    unsigned long flags;
+    int nedges;
+    int more;
+    int ret;
+
+    mutex_lock(&dht11_mutex);
+
+    INIT_COMPLETION(dht11_done);
+
+    // 起始信号：拉低，20ms 后由 hrtimer 释放总线
+    gpio_direction_output(DHT11_DATA, 0);
+    hrtimer_start(&dht11_start_timer, ktime_set(0, DHT11_START_MS * NSEC_PER_MSEC),
+                  HRTIMER_MODE_REL);
+
+    wait_for_completion_timeout(&dht11_done, msecs_to_jiffies(DHT11_START_MS + DHT11_XFER_MS));
+    hrtimer_cancel(&dht11_start_timer);
+
+    // 下标小于 dht11_nedges 的边沿已记录完，中断不会再改写
+    spin_lock_irqsave(&dht11_lock, flags);
+    nedges = dht11_nedges;
+    spin_unlock_irqrestore(&dht11_lock, flags);
+
+    ret = dht11_decode_edges(dht11_edge_ns, dht11_edge_level, nedges, data);
+    if (ret == DHT11_ERR_SHORT && nedges >= DHT11_DONE_EDGES)
+        usleep_range(DHT11_TAIL_US, DHT11_TAIL_US * 2);
+
+    spin_lock_irqsave(&dht11_lock, flags);
+    dht11_capturing = 0;
+    more = (dht11_nedges != nedges);    // 又记录到边沿，重新解码
+    nedges = dht11_nedges;
+    spin_unlock_irqrestore(&dht11_lock, flags);
+
+    // 总线恢复空闲的高电平
+    gpio_direction_output(DHT11_DATA, 1);
+
+    if (more)
+        ret = dht11_decode_edges(dht11_edge_ns, dht11_edge_level, nedges, data);
+    mutex_unlock(&dht11_mutex);
+
+    if (ret != 0)
+        pr_debug("dht11: decode failed %d, %d edges\n", ret, nedges);
+    return ret;
+}
+
+/**
+ * @brief 后台采样：完成一次传输，更新缓存，唤醒等待新数据的进程，然后安排下一次
+ */
+static void dht11_sample_fn(struct work_struct *work)
+{
+    unsigned char data[5];
+    unsigned long flags;
+    unsigned int delay_ms;
+    int ret;
+
+    ret = dht11_transfer(data);
+
+    spin_lock_irqsave(&dht11_rec_lock, flags);
+    dht11_rec.status = ret;
+    dht11_rec.seq++;
+    if (ret == 0) {
+        dht11_rec.timestamp_ns = ktime_to_ns(ktime_get());
+        dht11_rec.hum_int = data[0];
+        dht11_rec.hum_dec = data[1];
+        dht11_rec.temp_int = data[2];
+        dht11_rec.temp_dec = data[3];
     }
-    return 0;
+    spin_unlock_irqrestore(&dht11_rec_lock, flags);
+
+    wake_up_interruptible_all(&dht11_waitq);
+
+    delay_ms = max_t(unsigned int, ACCESS_ONCE(interval_ms), DHT11_MIN_INTERVAL_MS);
+    schedule_delayed_work(&dht11_sample_work, msecs_to_jiffies(delay_ms));
 }
 
-static unsigned char get_value(void)
+static void dht11_get_record(struct dht11_record *rec)
 {
-    int i;
-    int timeout = 0;
-    int ret_data = 0;
-
-    for(i = 0; i < 8; i++){
-        timeout = 0;
-        while(!gpio_get_value(DHT11_DATA)){
-            timeout++;
-            udelay(1);
-            if(timeout > 160){
-                printk(KERN_ERR "DHT11 timeout error\n");
-                return -ETIMEDOUT; // 直接返回错误
-            }
-        }
-
-        udelay(22);
-        ret_data <<= 1;
-        if(gpio_get_value(DHT11_DATA)){
-            ret_data |= 0x01;
-        }
-
-        timeout = 0;
-        while(gpio_get_value(DHT11_DATA)){
-            timeout++;
-            udelay(1);
-            if(timeout > 200){
-                printk(KERN_ERR "DHT11 timeout error\n");
-                return -ETIMEDOUT; // 直接返回错误
+    unsigned long flags;
+
+    spin_lock_irqsave(&dht11_rec_lock, flags);
+    *rec = dht11_rec;
+    spin_unlock_irqrestore(&dht11_rec_lock, flags);
+}
+
+/**
+ * @brief 等待 seq 之后的下一次采样完成
+ */
+static int dht11_wait_after(unsigned int seq)
+{
+    return wait_event_interruptible(dht11_waitq, ACCESS_ONCE(dht11_rec.seq) != seq);
+}
+
+static long dht11_ioctl(struct file *pFile, unsigned int cmd, unsigned long arg)
+{
+    struct dht11_record rec;
+    unsigned char buf[4];
+    unsigned int ms;
+
+    switch (cmd) {
+        case GET_DHT11_DATA:
+            // 打开后的第一次采样还没完成时等它一次，之后总是立即返回
+            dht11_get_record(&rec);
+            if (rec.seq == 0) {
+                if (dht11_wait_after(0))
+                    return -ERESTARTSYS;
+                dht11_get_record(&rec);
             }
-        }
+            if (rec.timestamp_ns == 0)
+                return rec.status;
+
+            // 温度在前，湿度在后
+            buf[0] = rec.temp_int;
+            buf[1] = rec.temp_dec;
+            buf[2] = rec.hum_int;
+            buf[3] = rec.hum_dec;
+            if (copy_to_user((void __user *)arg, buf, sizeof(buf)))
+                return -EFAULT;
+            return 0;
+        case DHT11_IOCTL_GET_RECORD:
+            dht11_get_record(&rec);
+            break;
+        case DHT11_IOCTL_WAIT_FRESH:
+            dht11_get_record(&rec);
+            if (dht11_wait_after(rec.seq))
+                return -ERESTARTSYS;
+            dht11_get_record(&rec);
+            break;
+        case DHT11_IOCTL_SET_INTERVAL:
+            if (get_user(ms, (unsigned int __user *)arg))
+                return -EFAULT;
+            if (ms < DHT11_MIN_INTERVAL_MS)
+                return -EINVAL;
+            interval_ms = ms;       // 下一次采样之后生效
+            return 0;
+        default:
+            return -ENOTTY;
     }
-    return ret_data;
+
+    if (copy_to_user((void __user *)arg, &rec, sizeof(rec)))
+        return -EFAULT;
+    return 0;
 }
 
 module_init(chrDevInit);
 module_exit(chrDevExit);
 MODULE_AUTHOR("lium <123456@qq.com>");
-MODULE_DESCRIPTION("LED Control Driver using GPIOE[13]");
+MODULE_DESCRIPTION("DHT11 Driver using GPIOB[29]");
 MODULE_LICENSE("GPL");
 MODULE_VERSION("2025-09-20_V1.0.1");
 /*************************************************************************
  * 改动历史纪录：
  * Revision 1.0, 2025-09-20, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 去掉 local_irq_save 和 udelay 忙等：起始信号由 hrtimer 结束，
+ *           边沿中断记录时间戳，传输结束后按高电平宽度解码.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 设备打开期间由 delayed work 周期采样并缓存，ioctl 直接返回缓存；
+ *           新增 DHT11_IOCTL_GET_RECORD/WAIT_FRESH/SET_INTERVAL.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 解码移到 dht11_decode.h(与硬件无关，可在主机上测试)，增加去毛刺；
+ *           有毛刺时记满 84 个边沿后继续记录 1ms 再解码.
  *************************************************************************/
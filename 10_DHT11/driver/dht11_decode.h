@@ -0,0 +1,173 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: dht11_decode.h
+ *   软件模块: DHT11 解码
+ *   功    能: 把一次传输的电平脉冲序列 {电平, 宽度 us} 解码为 5 个字节，
+ *             不访问硬件、不依赖时间，驱动和主机上的测试程序(../host)共用。
+ *             1. 宽度小于 DHT11_GLITCH_US 的脉冲视为毛刺，连续的毛刺累计宽度：
+ *                两侧正常脉冲电平相同时，累计宽度不足 DHT11_GLITCH_US 则三者合并，
+ *                否则是一个被毛刺打断的反向脉冲；两侧电平不同时(毛刺出现在跳变处)
+ *                累计宽度平分给两侧；
+ *                相邻的同电平脉冲合并(中断延迟时读到的电平可能重复)；
+ *             2. 跳过应答信号之前的脉冲，应答信号的 80us 高电平之后依次是
+ *                40 个数据位，高电平宽于 DHT11_BIT_THRESHOLD_US 为 1；
+ *             3. 校验和 = 前 4 个字节之和的低 8 位。
+ *
+ ************************************************************************/
+#ifndef DHT11_DECODE_H_
+#define DHT11_DECODE_H_
+
+#if defined(__KERNEL__)
+# include <linux/errno.h>
+#else
+# include <errno.h>
+#endif
+
+/**时序参数(us)，见 DHT11 手册 */
+#define DHT11_RESP_MIN_US       60      // 应答信号的高电平约 80us
+#define DHT11_BIT_THRESHOLD_US  48      // 数据位高电平 26~28us 为 0，70us 为 1
+#define DHT11_GLITCH_US         10      // 比它短的脉冲是毛刺，正常脉冲最短约 26us
+#define DHT11_DATA_BITS         40
+
+/**解码失败的原因，取负的 errno，驱动直接返回给应用层 */
+#define DHT11_ERR_NO_RESPONSE   (-ETIMEDOUT)    // 没有找到应答信号
+#define DHT11_ERR_SHORT         (-ENODATA)      // 数据位不足 40 个
+#define DHT11_ERR_CHECKSUM      (-EIO)          // 校验和错误
+
+/**一个电平脉冲 */
+typedef struct TDht11Pulse_t {
+    unsigned int level;                 // 0 低 1 高
+    unsigned int width_us;
+} TDht11Pulse_t;
+
+/**解码状态，逐个脉冲送入 */
+typedef struct TDht11Decoder_t {
+    int bit;                            // -1 等待应答信号，0~40 已解出的位数
+    unsigned int level;                 // 正在合并的脉冲
+    unsigned int width_us;
+    unsigned int glitch_us;             // 其后尚未归属的毛刺的总宽度
+    int have;                           // 是否有正在合并的脉冲
+    unsigned char data[5];
+} TDht11Decoder_t;
+
+static inline void dht11_decoder_init(TDht11Decoder_t *dec)
+{
+    int i;
+
+    dec->bit = -1;
+    dec->level = 0;
+    dec->width_us = 0;
+    dec->glitch_us = 0;
+    dec->have = 0;
+    for (i = 0; i < 5; i++)
+        dec->data[i] = 0;
+}
+
+/**处理一个合并、去毛刺之后的脉冲，只有高电平携带信息 */
+static inline void dht11_decoder_emit(TDht11Decoder_t *dec, unsigned int level, unsigned int width_us)
+{
+    if (!level || dec->bit >= DHT11_DATA_BITS)
+        return;
+    if (dec->bit < 0) {
+        if (width_us >= DHT11_RESP_MIN_US)
+            dec->bit = 0;               // 应答信号，下一个高电平是第 0 位
+        return;
+    }
+    dec->data[dec->bit / 8] <<= 1;
+    if (width_us > DHT11_BIT_THRESHOLD_US)
+        dec->data[dec->bit / 8] |= 1;
+    dec->bit++;
+}
+
+/**
+ * @brief 送入一个原始脉冲
+ */
+static inline void dht11_decoder_push(TDht11Decoder_t *dec, unsigned int level, unsigned int width_us)
+{
+    unsigned int half;
+
+    level = !!level;
+    if (!dec->have) {
+        dec->level = level;
+        dec->width_us = width_us;
+        dec->have = 1;
+        return;
+    }
+    if (width_us < DHT11_GLITCH_US) {
+        dec->glitch_us += width_us;     // 等下一个正常脉冲到来再决定归属
+        return;
+    }
+    if (level == dec->level) {
+        if (dec->glitch_us < DHT11_GLITCH_US) {
+            dec->width_us += dec->glitch_us + width_us;
+        } else {
+            dht11_decoder_emit(dec, dec->level, dec->width_us);
+            dht11_decoder_emit(dec, !level, dec->glitch_us);
+            dec->width_us = width_us;
+        }
+        dec->glitch_us = 0;
+        return;
+    }
+    half = dec->glitch_us / 2;
+    dht11_decoder_emit(dec, dec->level, dec->width_us + half);
+    dec->level = level;
+    dec->width_us = dec->glitch_us - half + width_us;
+    dec->glitch_us = 0;
+}
+
+/**
+ * @brief 结束解码
+ * @param data 输出 湿度整数、湿度小数、温度整数、温度小数、校验和
+ * @return 成功返回 0，否则为 DHT11_ERR_*
+ */
+static inline int dht11_decoder_finish(TDht11Decoder_t *dec, unsigned char data[5])
+{
+    int i;
+
+    if (dec->have)
+        dht11_decoder_emit(dec, dec->level, dec->width_us + dec->glitch_us);
+    dec->have = 0;
+    dec->glitch_us = 0;
+
+    for (i = 0; i < 5; i++)
+        data[i] = dec->data[i];
+    if (dec->bit < 0)
+        return DHT11_ERR_NO_RESPONSE;
+    if (dec->bit < DHT11_DATA_BITS)
+        return DHT11_ERR_SHORT;
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4])
+        return DHT11_ERR_CHECKSUM;
+    return 0;
+}
+
+/**
+ * @brief 解码一个完整的脉冲序列
+ */
+static inline int dht11_decode_pulses(const TDht11Pulse_t *pulses, int n, unsigned char data[5])
+{
+    TDht11Decoder_t dec;
+    int i;
+
+    dht11_decoder_init(&dec);
+    for (i = 0; i < n; i++)
+        dht11_decoder_push(&dec, pulses[i].level, pulses[i].width_us);
+    return dht11_decoder_finish(&dec, data);
+}
+
+/**
+ * @brief 解码边沿序列：第 i 个脉冲为 level[i]，宽度为 edge_ns[i + 1] - edge_ns[i]
+ *        (驱动中断里记录的就是这种形式)，最后一个边沿之后的电平没有宽度，不参与解码
+ */
+static inline int dht11_decode_edges(const long long *edge_ns, const unsigned char *level, int n,
+                                     unsigned char data[5])
+{
+    TDht11Decoder_t dec;
+    int i;
+
+    dht11_decoder_init(&dec);
+    for (i = 0; i + 1 < n; i++)
+        dht11_decoder_push(&dec, level[i], (unsigned int)(edge_ns[i + 1] - edge_ns[i]) / 1000);
+    return dht11_decoder_finish(&dec, data);
+}
+
+#endif  /* DHT11_DECODE_H_ */
@@ -0,0 +1,349 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: dht11_replay.c
+ *   软件模块: DHT11 解码测试
+ *   功    能: 在主机上回放波形，测试 ../driver/dht11_decode.h 的解码结果与耗时。
+ *             1. 合成波形：随机温湿度按手册时序生成边沿序列，可加入
+ *                中断延迟抖动、毛刺、校验和错误、截断、无应答；
+ *             2. 文件波形：每行 "<时刻 ns> <边沿之后的电平>"，'#' 开头为注释，
+ *                "# expect 湿度整数 湿度小数 温度整数 温度小数" 给出期望值；
+ *             3. 基准：反复解码同一个波形，统计每次解码的耗时。
+ *             有任何必须通过的用例失败时返回 1。
+ *   用    法: ./dht11_replay                    合成用例 + 基准
+ *             ./dht11_replay 文件...            回放文件
+ *             ./dht11_replay --dump 文件        把一个合成波形写入文件
+ *
+ ************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dht11_decode.h"
+
+#define REPLAY_MAX_EDGES    256
+#define REPLAY_ROUNDS       2000        /**每个合成用例的波形数 */
+#define BENCH_ITERATIONS    1000000
+
+/**边沿序列，与驱动中断里记录的形式相同 */
+typedef struct TEdges_t {
+    long long ns[REPLAY_MAX_EDGES];
+    unsigned char level[REPLAY_MAX_EDGES];
+    int n;
+} TEdges_t;
+
+/**合成波形的参数 */
+typedef struct TWaveOpt_t {
+    unsigned int jitter_us;             /**每个边沿的时间戳延后 0~jitter_us(中断延迟) */
+    unsigned int glitch_permille;       /**每个脉冲中出现一个 1~5us 毛刺的概率(千分比) */
+    int bad_checksum;                   /**校验和字节加 1 */
+    int truncate;                       /**丢掉最后这么多个边沿 */
+    int no_response;                    /**没有应答信号 */
+} TWaveOpt_t;
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64*，结果可复现
+static unsigned int replay_rand(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned int)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void edges_add(TEdges_t *e, long long t_ns, unsigned int level) {
+    // 中断依次执行，记录的时间戳不会倒退
+    if (e->n > 0 && t_ns < e->ns[e->n - 1])
+        t_ns = e->ns[e->n - 1];
+    if (e->n < REPLAY_MAX_EDGES) {
+        e->ns[e->n] = t_ns;
+        e->level[e->n] = (unsigned char)level;
+        e->n++;
+    }
+}
+
+/**中断延迟，0~jitter_us(ns) */
+static long long replay_latency(const TWaveOpt_t *opt) {
+    return opt->jitter_us ? replay_rand() % (opt->jitter_us * 1000 + 1) : 0;
+}
+
+/**
+ * @brief 追加一个理想宽度的脉冲，按参数加入毛刺，时间戳加入中断延迟
+ * @param t 理想时刻(ns)，返回时推进 width_us
+ */
+static void wave_pulse(TEdges_t *e, long long *t, unsigned int level, unsigned int width_us,
+                       const TWaveOpt_t *opt) {
+    unsigned int at;
+    unsigned int glitch;
+
+    edges_add(e, *t + replay_latency(opt), level);
+
+    if (opt->glitch_permille && replay_rand() % 1000 < opt->glitch_permille && width_us > 12) {
+        // 在脉冲中间出现一个反向的短脉冲
+        at = 3 + replay_rand() % (width_us - 10);
+        glitch = 1 + replay_rand() % 5;
+        edges_add(e, *t + at * 1000LL + replay_latency(opt), !level);
+        edges_add(e, *t + (at + glitch) * 1000LL + replay_latency(opt), level);
+    }
+    *t += width_us * 1000LL;
+}
+
+/**
+ * @brief 按手册时序生成释放总线之后的边沿序列
+ */
+static void wave_make(TEdges_t *e, const unsigned char data[5], const TWaveOpt_t *opt) {
+    long long t = 0;
+    int i;
+
+    e->n = 0;
+    wave_pulse(e, &t, 1, 30, opt);                  // 释放总线，上拉
+    if (!opt->no_response) {
+        wave_pulse(e, &t, 0, 80, opt);              // 应答低电平
+        wave_pulse(e, &t, 1, 80, opt);              // 应答高电平
+        for (i = 0; i < DHT11_DATA_BITS; i++) {
+            wave_pulse(e, &t, 0, 50, opt);
+            wave_pulse(e, &t, 1, (data[i / 8] >> (7 - i % 8)) & 1 ? 70 : 27, opt);
+        }
+    } else {
+        for (i = 0; i < 10; i++) {                  // 总线上只有干扰
+            wave_pulse(e, &t, 0, 20, opt);
+            wave_pulse(e, &t, 1, 20, opt);
+        }
+    }
+    wave_pulse(e, &t, 0, 50, opt);                  // 结束
+    edges_add(e, t, 1);
+
+    e->n -= (opt->truncate < e->n) ? opt->truncate : e->n;
+}
+
+static void data_random(unsigned char data[5], int bad_checksum) {
+    data[0] = 20 + replay_rand() % 70;              // 湿度
+    data[1] = 0;
+    data[2] = replay_rand() % 50;                   // 温度
+    data[3] = replay_rand() % 10;
+    data[4] = (unsigned char)((data[0] + data[1] + data[2] + data[3]) & 0xFF);
+    if (bad_checksum)
+        data[4] += 1;
+}
+
+static const char *err_name(int ret) {
+    switch (ret) {
+        case 0:                         return "ok";
+        case DHT11_ERR_NO_RESPONSE:     return "no-response";
+        case DHT11_ERR_SHORT:           return "short";
+        case DHT11_ERR_CHECKSUM:        return "checksum";
+        default:                        return "?";
+    }
+}
+
+/**
+ * @brief 运行一个合成用例
+ * @param expect       期望的返回值，0 时还要求数据完全一致
+ * @param min_permille 必须达到的正确率(千分比)，0 表示只报告
+ * @return 未达到要求返回 -1
+ */
+static int case_run(const char *name, const TWaveOpt_t *opt, int expect, unsigned int min_permille) {
+    unsigned char data[5];
+    unsigned char out[5];
+    TEdges_t edges;
+    int good = 0;
+    int ret;
+    int r;
+
+    for (r = 0; r < REPLAY_ROUNDS; r++) {
+        data_random(data, opt->bad_checksum);
+        wave_make(&edges, data, opt);
+        ret = dht11_decode_edges(edges.ns, edges.level, edges.n, out);
+        if (ret == expect && (expect != 0 || memcmp(data, out, 5) == 0))
+            good++;
+    }
+
+    printf("%-28s expect %-12s %6.1f%%%s\n", name, err_name(expect),
+           good * 100.0 / REPLAY_ROUNDS,
+           (min_permille && good * 1000 < (int)min_permille * REPLAY_ROUNDS) ? "  FAIL" : "");
+    return (min_permille && good * 1000 < (int)min_permille * REPLAY_ROUNDS) ? -1 : 0;
+}
+
+static int suite_run(void) {
+    static const unsigned int jitters[] = { 0, 5, 10, 15, 20, 25, 30 };
+    static const unsigned int glitches[] = { 10, 50, 100, 200 };
+    TWaveOpt_t opt;
+    char name[64];
+    int failed = 0;
+    unsigned int i;
+
+    printf("==== synthetic waveforms (%d each) ====\n", REPLAY_ROUNDS);
+
+    for (i = 0; i < sizeof(jitters) / sizeof(jitters[0]); i++) {
+        memset(&opt, 0, sizeof(opt));
+        opt.jitter_us = jitters[i];
+        snprintf(name, sizeof(name), "jitter %u us", jitters[i]);
+        // 脉冲宽度的误差为 ±jitter_us，26us 的脉冲要宽于 DHT11_GLITCH_US，
+        // 15us 以内必须全部正确，更大的只报告
+        failed |= case_run(name, &opt, 0, jitters[i] <= 15 ? 1000 : 0);
+    }
+
+    for (i = 0; i < sizeof(glitches) / sizeof(glitches[0]); i++) {
+        memset(&opt, 0, sizeof(opt));
+        opt.glitch_permille = glitches[i];
+        opt.jitter_us = 5;
+        snprintf(name, sizeof(name), "glitch %u%%, jitter 5 us", glitches[i] / 10);
+        failed |= case_run(name, &opt, 0, 1000);
+    }
+
+    memset(&opt, 0, sizeof(opt));
+    opt.bad_checksum = 1;
+    opt.jitter_us = 5;
+    failed |= case_run("bad checksum", &opt, DHT11_ERR_CHECKSUM, 1000);
+
+    memset(&opt, 0, sizeof(opt));
+    opt.truncate = 20;
+    failed |= case_run("truncated 20 edges", &opt, DHT11_ERR_SHORT, 1000);
+
+    memset(&opt, 0, sizeof(opt));
+    opt.no_response = 1;
+    failed |= case_run("no response", &opt, DHT11_ERR_NO_RESPONSE, 1000);
+
+    return failed ? -1 : 0;
+}
+
+static void bench_run(void) {
+    unsigned char data[5];
+    unsigned char out[5];
+    unsigned long long start;
+    unsigned long long elapsed;
+    volatile int sink = 0;
+    TWaveOpt_t opt;
+    TEdges_t edges;
+    int i;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.jitter_us = 5;
+    data_random(data, 0);
+    wave_make(&edges, data, &opt);
+
+    start = now_ns();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+        sink += dht11_decode_edges(edges.ns, edges.level, edges.n, out) + out[0];
+    elapsed = now_ns() - start;
+
+    printf("==== benchmark ====\n");
+    printf("decode %d edges: %.1f ns per reading\n", edges.n, (double)elapsed / BENCH_ITERATIONS);
+    (void)sink;
+}
+
+/**
+ * @brief 读取边沿文件
+ * @param expect     文件中有 "# expect" 行时填入期望的前 4 个字节
+ * @param has_expect 是否有期望值
+ */
+static int file_load(const char *path, TEdges_t *e, unsigned char expect[4], int *has_expect) {
+    unsigned int v[4];
+    long long t;
+    unsigned int level;
+    char line[256];
+    FILE *fp;
+    int i;
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    e->n = 0;
+    *has_expect = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "# expect %u %u %u %u", &v[0], &v[1], &v[2], &v[3]) == 4) {
+            for (i = 0; i < 4; i++)
+                expect[i] = (unsigned char)v[i];
+            *has_expect = 1;
+            continue;
+        }
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (sscanf(line, "%lld %u", &t, &level) != 2) {
+            fprintf(stderr, "%s: bad line: %s", path, line);
+            fclose(fp);
+            return -1;
+        }
+        edges_add(e, t, level);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int file_replay(const char *path) {
+    unsigned char expect[4];
+    unsigned char out[5];
+    int has_expect;
+    TEdges_t edges;
+    int ret;
+
+    if (file_load(path, &edges, expect, &has_expect) < 0)
+        return -1;
+
+    ret = dht11_decode_edges(edges.ns, edges.level, edges.n, out);
+    printf("%s: %d edges, %s, humidity %u.%u, temperature %u.%u",
+           path, edges.n, err_name(ret), out[0], out[1], out[2], out[3]);
+    if (has_expect) {
+        if (ret != 0 || memcmp(out, expect, 4) != 0) {
+            printf("  FAIL (expect %u.%u %u.%u)\n", expect[0], expect[1], expect[2], expect[3]);
+            return -1;
+        }
+        printf("  ok\n");
+        return 0;
+    }
+    printf("\n");
+    return ret == 0 ? 0 : -1;
+}
+
+static int file_dump(const char *path) {
+    unsigned char data[5];
+    TWaveOpt_t opt;
+    TEdges_t edges;
+    FILE *fp;
+    int i;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.jitter_us = 10;
+    opt.glitch_permille = 50;
+    data_random(data, 0);
+    wave_make(&edges, data, &opt);
+
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "# synthetic DHT11 waveform: jitter 10 us, glitch 5%%\n");
+    fprintf(fp, "# expect %u %u %u %u\n", data[0], data[1], data[2], data[3]);
+    fprintf(fp, "# time_ns level\n");
+    for (i = 0; i < edges.n; i++)
+        fprintf(fp, "%lld %u\n", edges.ns[i], edges.level[i]);
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    int i;
+
+    if (argc == 3 && strcmp(argv[1], "--dump") == 0)
+        return file_dump(argv[2]) < 0 ? 1 : 0;
+
+    if (argc > 1) {
+        for (i = 1; i < argc; i++)
+            failed |= file_replay(argv[i]);
+        return failed ? 1 : 0;
+    }
+
+    failed = suite_run();
+    bench_run();
+    return failed ? 1 : 0;
+}
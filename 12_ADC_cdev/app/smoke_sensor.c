@@ -8,6 +8,10 @@
  *   生成日期: 2025-10-2
  *   作    者: lium
  *   功    能: 通过片上ADC采集烟雾传感器数据
+ *   用    法: ./zsf12                  交互输入通道，每秒读一次
+ *             ./zsf12 scan [通道掩码]   每秒扫描一次多个通道，默认 0xF
+ *             以上模式前可加 -f 模式,taps[,order[,decimation]] 设置驱动中的滤波，
+ *             模式为 none/mean/median/cic，如 ./zsf12 -f median,5 scan 0x3
  *
  ************************************************************************/
 #include <stdio.h>
@@ -17,6 +21,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <stdlib.h>
 
 /**驱动和应用层的命令要一致 */
 #define GEC6818_ADC_IN0   _IOR('A', 0, unsigned long) // 读取通道0的命令
@@ -24,6 +29,89 @@
 #define GEC6818_ADC_IN2   _IOR('A', 2, unsigned long) // 读取通道2的命令
 #define GEC6818_ADC_IN3   _IOR('A', 3, unsigned long) // 读取通道3的命令
 
+/**多通道扫描，与驱动中的定义一致 */
+struct adc_scan {
+    unsigned int mask;
+    unsigned int count;
+    unsigned short raw[4];
+    unsigned short mv[4];
+    unsigned short value[4];        // 16 位定标值 raw << 4
+};
+
+#define ADC_IOCTL_SCAN    _IOWR('A', 4, struct adc_scan)
+
+/**驱动中的过采样滤波，与驱动 adc_filter.h 中的定义一致 */
+struct adc_filter_cfg {
+    unsigned int mode;              // 0 不滤波 1 滑动平均 2 中值 3 CIC
+    unsigned int taps;
+    unsigned int order;
+    unsigned int decimation;
+};
+
+#define ADC_IOCTL_SET_FILTER    _IOW('A', 10, struct adc_filter_cfg)
+#define ADC_IOCTL_GET_FILTER    _IOR('A', 11, struct adc_filter_cfg)
+
+/**
+ * @brief 解析 "模式,taps[,order[,decimation]]" 并设置驱动的滤波
+ * @return 成功返回 0
+ */
+static int filter_set(int fd, const char *arg)
+{
+    static const char *const names[] = { "none", "mean", "median", "cic" };
+    struct adc_filter_cfg cfg;
+    char name[16];
+    unsigned int i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    if (sscanf(arg, "%15[a-z],%u,%u,%u", name, &cfg.taps, &cfg.order, &cfg.decimation) < 1) {
+        printf("Invalid filter: %s\n", arg);
+        return -1;
+    }
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0)
+            break;
+    }
+    if (i == sizeof(names) / sizeof(names[0])) {
+        printf("Invalid filter mode: %s\n", name);
+        return -1;
+    }
+    cfg.mode = i;
+    if (ioctl(fd, ADC_IOCTL_SET_FILTER, &cfg) != 0) {
+        perror("ADC_IOCTL_SET_FILTER");
+        return -1;
+    }
+    ioctl(fd, ADC_IOCTL_GET_FILTER, &cfg);
+    printf("filter %s: taps %u, order %u, decimation %u\n", names[cfg.mode], cfg.taps, cfg.order, cfg.decimation);
+    return 0;
+}
+
+/**
+ * @brief 每秒扫描一次 mask 中的通道并打印
+ */
+static int scan_run(int fd, unsigned int mask)
+{
+    struct adc_scan scan;
+    unsigned int ch;
+    unsigned int i;
+
+    while (1) {
+        scan.mask = mask;
+        if (ioctl(fd, ADC_IOCTL_SCAN, &scan) != 0) {
+            perror("ADC_IOCTL_SCAN");
+            return -1;
+        }
+        for (ch = 0, i = 0; ch < 4; ch++) {
+            if (mask & (1 << ch)) {
+                printf("ch%u %4u mV (%7.2f)  ", ch, scan.mv[i], scan.value[i] / 16.0);
+                i++;
+            }
+        }
+        printf("\n");
+        sleep(1);
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     int fd = -1;
@@ -39,6 +127,22 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (argc >= 3 && strcmp(argv[1], "-f") == 0) {
+        if (filter_set(fd, argv[2]) != 0) {
+            close(fd);
+            return -1;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "scan") == 0) {
+        ret = scan_run(fd, argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 0) : 0xF);
+        close(fd);
+        return ret;
+    }
+
     // 提示用户输入通道号
     printf("1. Please input the channel (0, 1, 2, 3...): ");
     scanf("%d", &channel);
@@ -84,4 +188,8 @@ int main(int argc, char **argv)
  * 改动历史纪录：
  * Revision 1.0, 2025-10-02, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 增加 scan 模式，一次 ioctl 读取多个通道.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 增加 -f 选项设置驱动中的过采样滤波，扫描结果显示带小数的 16 位定标值.
  *************************************************************************/
@@ -8,6 +8,8 @@
  *   生成日期: 2025-10-2
  *   作    者: lium
  *   功    能: 通过片上ADC采集烟雾传感器数据
+ *             ioctl(ADC_IOCTL_SET_FILTER) 设置过采样滤波(滑动平均/中值/CIC 抽取)后，
+ *             单次转换和扫描的每个结果在内核中转换 adc_filter_burst() 次并滤波.
  *
  ************************************************************************/
 #include <linux/kernel.h>      // printk、内核日志宏和常用内核函数
@@ -17,6 +19,15 @@
 #include <linux/io.h>          // ioremap/iounmap/ioread32/iowrite32，内存映射IO访问
 #include <linux/ioctl.h>       // _IOR/_IOW/_IO 宏，用于 ioctl 命令定义
 #include <linux/ioport.h>      // request_mem_region/release_mem_region，申请物理地址资源
+#include <linux/interrupt.h>   // request_irq/free_irq，转换结束中断
+#include <linux/completion.h>  // 进程等待转换结束
+#include <linux/mutex.h>
+#include <mach/platform.h>     // IRQ_PHY_ADC
+
+#include "drv_stats.h"
+#include "adc_filter.h"
+#define CREATE_TRACE_POINTS
+#include "adc12c_trace.h"
 #include <linux/cdev.h>        // struct cdev、cdev_init、cdev_add、cdev_del，字符设备注册管理
 #include <linux/device.h>      // class_create/device_create/device_destroy，生成 /dev/xxx 节点
 
@@ -42,14 +53,56 @@ static struct device *adc_device;                           // 设备节点对
 static void __iomem *adc_base_va;                           // adc的虚拟地址基址
 static void __iomem *adcon_va;
 static void __iomem *adcdat_va;
+static void __iomem *adcintenb_va;
+static void __iomem *adcintclr_va;
 static void __iomem *prescalercon_va;
 
+/**ADC 中断 */
+#define ADC_PRESCALER           199                         // ADC 工作频率 = 200MHz / (199+1) = 1MHz
+#define ADC_CONVERT_TIMEOUT_MS  10                          // 一次转换约 5us，超时说明中断没有到来
+
+static DEFINE_MUTEX(adc_mutex);                             // 一次只进行一个转换，同时保护 adc_users
+static DECLARE_COMPLETION(adc_done);                        // 转换结束，由中断通知
+static int adc_busy;                                        // 为 1 时本驱动在等待转换结束
+static int adc_users;                                       // 打开的次数，> 0 时 ADC 保持上电
+static struct adc_filter_cfg adc_filter_conf = {            // 由 adc_mutex 保护，默认不滤波
+    .mode = ADC_FILTER_NONE, .taps = 1, .order = 1, .decimation = 1,
+};
+
+static irqreturn_t adc_irq_handler(int irq, void *dev_id);
+
+/**debugfs 计数器：/sys/kernel/debug/adc12_cdev/stats */
+enum {
+    ADC_STAT_CONVERSIONS = 0,
+    ADC_STAT_ERRORS,
+    ADC_STAT_NUM
+};
+static const char *const adc_stat_names[ADC_STAT_NUM] = { "conversions", "errors" };
+static struct drv_stats adc_stats;
+
 /**ioctl */
 #define GEC6818_ADC_IN0   _IOR('A', 0, unsigned long)       // ADC通道0
 #define GEC6818_ADC_IN1   _IOR('A', 1, unsigned long)       // ADC通道1
 #define GEC6818_ADC_IN2   _IOR('A', 2, unsigned long)       // ADC通道2
 #define GEC6818_ADC_IN3   _IOR('A', 3, unsigned long)       // ADC通道3
 
+/**多通道扫描：依次转换 mask 中的通道，结果按通道号从小到大紧凑排列 */
+#define ADC_CHANNELS            4
+
+struct adc_scan {
+    unsigned int mask;                  // 输入：bit n 为 1 表示转换通道 n
+    unsigned int count;                 // 输出：转换的通道数
+    unsigned short raw[ADC_CHANNELS];   // 输出：12 位值，滤波时为滤波结果四舍五入
+    unsigned short mv[ADC_CHANNELS];    // 输出：电压(mV)
+    unsigned short value[ADC_CHANNELS]; // 输出：16 位定标值 raw << 4，滤波时低 4 位有效
+};
+
+#define ADC_IOCTL_SCAN    _IOWR('A', 4, struct adc_scan)
+
+/**滤波参数见 adc_filter.h，对之后的单次转换和扫描生效 */
+#define ADC_IOCTL_SET_FILTER    _IOW('A', 10, struct adc_filter_cfg)
+#define ADC_IOCTL_GET_FILTER    _IOR('A', 11, struct adc_filter_cfg)    // 取得补全了默认值的参数
+
 /**文件操作集 */
 static int adc_open(struct inode *inode, struct file *pFile);
 static int adc_close(struct inode *inode, struct file *pFile);
@@ -119,11 +172,23 @@ static int __init adcInit(void)
     }
     adcon_va        = adc_base_va + 0x00;
     adcdat_va       = adc_base_va + 0x04;
+    adcintenb_va    = adc_base_va + 0x08;
+    adcintclr_va    = adc_base_va + 0x0C;
     prescalercon_va = adc_base_va + 0x10;
 
+    /**7. 转换结束中断 */
+    ret = request_irq(IRQ_PHY_ADC, adc_irq_handler, IRQF_SHARED, DEVICE_NAME, &adc_done);
+    if (ret) {
+        printk(KERN_ERR "request_irq %d failed\n", IRQ_PHY_ADC);
+        goto err_request_irq;
+    }
+
+    drv_stats_init(&adc_stats, "adc12_cdev", adc_stat_names, ADC_STAT_NUM);
     printk(KERN_INFO "adc char driver init success\n");
     return 0;
 
+err_request_irq:
+    iounmap(adc_base_va);
 err_ioremap:
     device_destroy(adc_class, dev_no);
 err_device_create:
@@ -138,6 +203,8 @@ err_cdev_add:
 /**主函数出口 */
 static void __exit adcExit(void)
 {
+    drv_stats_exit(&adc_stats);
+    free_irq(IRQ_PHY_ADC, &adc_done);
     iounmap(adc_base_va);
     device_destroy(adc_class, dev_no);
     class_destroy(adc_class);
@@ -147,91 +214,241 @@ static void __exit adcExit(void)
     printk(KERN_INFO "adc char driver exit\n");
 }
 
+/**-------- ADC 上电/转换 -------- */
+/**
+ * @brief 转换结束中断，与内核自带的 ADC 驱动共用中断号，不是本驱动启动的转换不处理
+ */
+static irqreturn_t adc_irq_handler(int irq, void *dev_id)
+{
+    if (!ACCESS_ONCE(adc_busy))
+        return IRQ_NONE;
+    adc_busy = 0;
+    iowrite32(1, adcintclr_va);     // 清除中断挂起位
+    complete(&adc_done);
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief 第一次打开时上电，设备打开期间保持，每次转换不再重新配置
+ */
+static void adc_hw_on(void)
+{
+    // [9:0] = 199，预分频值 199+1，[15] = 1 启用预分频
+    iowrite32((ioread32(prescalercon_va) & ~0x3FF) | ADC_PRESCALER, prescalercon_va);
+    iowrite32(ioread32(prescalercon_va) | (1 << 15), prescalercon_va);
+
+    // [2] = 0，开启电源
+    iowrite32(ioread32(adcon_va) & ~(1 << 2), adcon_va);
+
+    // 清除挂起位，使能转换结束中断
+    iowrite32(1, adcintclr_va);
+    iowrite32(1, adcintenb_va);
+}
+
+/**
+ * @brief 最后一次关闭时断电
+ */
+static void adc_hw_off(void)
+{
+    iowrite32(0, adcintenb_va);
+    // [15] = 0 关闭预分频(CLKIN)，[2] = 1 关闭电源
+    iowrite32(ioread32(prescalercon_va) & ~(1 << 15), prescalercon_va);
+    iowrite32(ioread32(adcon_va) | (1 << 2), adcon_va);
+}
+
+/**
+ * @brief 转换一次，等待中断期间睡眠，调用者须已打开设备并持有 adc_mutex
+ * @param channel 通道 0~3
+ * @param raw     12 位原始值
+ * @return 成功返回 0，超时返回 -ETIMEDOUT
+ */
+static int adc_convert_locked(unsigned int channel, unsigned int *raw)
+{
+    INIT_COMPLETION(adc_done);
+    adc_busy = 1;
+
+    // [5:3] 选择通道，[0] = 1 启动转换，转换结束时硬件清零并产生中断
+    iowrite32((ioread32(adcon_va) & ~(7 << 3)) | (channel << 3), adcon_va);
+    iowrite32(ioread32(adcon_va) | (1 << 0), adcon_va);
+
+    if (wait_for_completion_timeout(&adc_done, msecs_to_jiffies(ADC_CONVERT_TIMEOUT_MS)) == 0) {
+        adc_busy = 0;
+        return -ETIMEDOUT;
+    }
+    *raw = ioread32(adcdat_va) & 0xFFF;     // 低12位有效
+    return 0;
+}
+
+/**
+ * @brief 按当前滤波参数转换 adc_filter_burst() 次，取最后一个输出，
+ *        每次从清空的状态开始，结果不受之前的转换影响；调用者持有 adc_mutex
+ * @param value 16 位定标值
+ * @return 成功返回 0，转换超时返回 -ETIMEDOUT，没有得到输出返回 -EIO
+ */
+static int adc_convert_filtered_locked(unsigned int channel, unsigned int *value)
+{
+    struct adc_filter filter;
+    unsigned int n = adc_filter_burst(&adc_filter_conf);
+    unsigned int raw;
+    unsigned int i;
+    int have = 0;
+    int ret = 0;
+
+    adc_filter_reset(&filter, &adc_filter_conf);
+    for (i = 0; i < n && ret == 0; i++) {
+        ret = adc_convert_locked(channel, &raw);
+        if (ret == 0 && adc_filter_push(&filter, raw, value))
+            have = 1;               // adc_filter_check() 保证第 n 个输入有输出
+    }
+    drv_stats_add(&adc_stats, ADC_STAT_CONVERSIONS, ret == 0 ? n : i - 1);
+    if (ret == 0 && !have)
+        ret = -EIO;                 // 不把调用者未初始化的 value 当作结果
+    return ret;
+}
+
+/**单次(滤波)转换 */
+static int adc_convert(unsigned int channel, unsigned int *value)
+{
+    int ret;
+
+    mutex_lock(&adc_mutex);
+    ret = adc_convert_filtered_locked(channel, value);
+    mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+/**
+ * @brief 依次转换 mask 中的通道，期间一直持有 adc_mutex，不被其他转换插入
+ * @return 成功返回 0，mask 为空或含有不存在的通道返回 -EINVAL
+ */
+static int adc_scan(struct adc_scan *scan)
+{
+    unsigned int value = 0;
+    unsigned int ch;
+    int ret = 0;
+
+    scan->count = 0;
+    if (scan->mask == 0 || (scan->mask >> ADC_CHANNELS) != 0)
+        return -EINVAL;
+
+    mutex_lock(&adc_mutex);
+    for (ch = 0; ch < ADC_CHANNELS && ret == 0; ch++) {
+        if (!(scan->mask & (1 << ch)))
+            continue;
+        ret = adc_convert_filtered_locked(ch, &value);
+        if (ret == 0) {
+            scan->raw[scan->count] = (value + (1 << ADC_FILTER_FRAC_BITS >> 1)) >> ADC_FILTER_FRAC_BITS;
+            scan->mv[scan->count] = adc_filter_to_mv(value);
+            scan->value[scan->count] = value;
+            scan->count++;
+        }
+    }
+    mutex_unlock(&adc_mutex);
+    return ret;
+}
+
 /**-------- open/release/read/ioctl -------- */
 static int adc_open(struct inode *inode, struct file *pFile)
 {
-    printk(KERN_INFO "adc_open success\n");
+    mutex_lock(&adc_mutex);
+    if (adc_users++ == 0)
+        adc_hw_on();
+    mutex_unlock(&adc_mutex);
+
+    pr_debug("adc_open success\n");
     return 0;
 }
 
 static int adc_close(struct inode *inode, struct file *pFile)
 {
-    printk(KERN_INFO "adc device close\n");
+    mutex_lock(&adc_mutex);
+    if (--adc_users == 0)
+        adc_hw_off();
+    mutex_unlock(&adc_mutex);
+
+    pr_debug("adc device close\n");
     return 0;
 }
 
 static ssize_t adc_read(struct file *pFile, char __user *buf, size_t count, loff_t *ppos)
 {
-    printk(KERN_INFO "adc adc_read success\n");
+    pr_debug("adc_read\n");
     return 0;
 }
 
 static long adc_ioctl(struct file *pFile, unsigned int cmd, unsigned long arg)
 {
-    unsigned long adc_value = 0;
+    struct adc_scan scan;
+    struct adc_filter_cfg fcfg;
+    unsigned int adc_value = 0;
     unsigned long adc_vol = 0;
-    unsigned int reg_val;
+    unsigned int channel;
     int ret = -1;
 
-    printk(KERN_INFO "adc ioctl: cmd = %d\n", cmd);
+    pr_debug("adc_ioctl: cmd = 0x%x\n", cmd);
 
     switch (cmd) {
+        case ADC_IOCTL_SET_FILTER:
+            if (copy_from_user(&fcfg, (void __user *)arg, sizeof(fcfg)))
+                return -EFAULT;
+            ret = adc_filter_check(&fcfg);
+            if (ret != 0)
+                return ret;
+            mutex_lock(&adc_mutex);
+            adc_filter_conf = fcfg;
+            mutex_unlock(&adc_mutex);
+            return 0;
+        case ADC_IOCTL_GET_FILTER:
+            mutex_lock(&adc_mutex);
+            fcfg = adc_filter_conf;
+            mutex_unlock(&adc_mutex);
+            if (copy_to_user((void __user *)arg, &fcfg, sizeof(fcfg)))
+                return -EFAULT;
+            return 0;
+        case ADC_IOCTL_SCAN:
+            if (copy_from_user(&scan, (void __user *)arg, sizeof(scan)))
+                return -EFAULT;
+            ret = adc_scan(&scan);
+            if (ret != 0) {
+                drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+                return ret;
+            }
+            if (copy_to_user((void __user *)arg, &scan, sizeof(scan))) {
+                drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+                return -EFAULT;
+            }
+            return 0;
         case GEC6818_ADC_IN0:   // [5:3]=000 通道0
-            reg_val = ioread32(adcon_va);
-            reg_val &= (~(7 << 3));
-            iowrite32(reg_val, adcon_va);
-            break;
         case GEC6818_ADC_IN1:   // [5:3]=001 通道1
-            iowrite32((ioread32(adcon_va) & ((~(7 << 3)))), adcon_va);
-            iowrite32((ioread32(adcon_va) | ((1 << 3))), adcon_va);
-            break;
         case GEC6818_ADC_IN2:   // [5:3]=010 通道2
-            iowrite32((ioread32(adcon_va) & ((~(7 << 3)))), adcon_va);
-            iowrite32((ioread32(adcon_va) | ((2 << 3))), adcon_va);
-            break;
         case GEC6818_ADC_IN3:   // [5:3]=011 通道3
-            iowrite32((ioread32(adcon_va) & ((~(7 << 3)))), adcon_va);
-            iowrite32((ioread32(adcon_va) | ((3 << 3))), adcon_va);
+            channel = _IOC_NR(cmd);
             break;
         default:
-            printk(KERN_ERR "adc_ioctl failed\n");
+            drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+            pr_debug("adc_ioctl: unknown cmd 0x%x\n", cmd);
             return -ENOIOCTLCMD;
     }
 
-    // 将ADC的电源开启 [2] = 0，开启电源
-    iowrite32(ioread32(adcon_va) & ~(1 << 2), adcon_va);
-
-    // [9:0] = 199 + 1 = 200，预分频值设置为 199+1，ADC 工作频率 = 200MHz / (199+1) = 1MHz
-    iowrite32(ioread32(prescalercon_va) & ~(0x3FF << 0), prescalercon_va);  // 清除低10位
-    iowrite32(ioread32(prescalercon_va) | (199 << 0), prescalercon_va);     // 设置为199
-
-    // 预分频值使能 [15] = 1，启用预分频
-    iowrite32(ioread32(prescalercon_va) | (1 << 15), prescalercon_va);
-
-    // ADC 使能 [0] = 1，启动 ADC 转换
-    iowrite32(ioread32(adcon_va) | (1 << 0), adcon_va);
-
-    // 等待 AD 转换结束 [0] = 0，表示转换完成
-    while (ioread32(adcon_va) & (1 << 0));
-
-    // 读取12bit数据（低12位有效）
-    adc_value = ioread32(adcdat_va) & 0xFFF;
-
-    // 关闭CLKIN时钟输入 [15]=0, disable
-    iowrite32(ioread32(prescalercon_va) & ~(1 << 15), prescalercon_va);
-
-    // 关闭ADC电源 [2]=1, power off
-    iowrite32(ioread32(adcon_va) | (1 << 2), adcon_va);
+    // ADC 在 open 时已上电，这里只选择通道、启动转换并等待中断
+    ret = adc_convert(channel, &adc_value);
+    if (ret != 0) {
+        drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+        return ret;
+    }
 
     // 将AD转换的结果值换算为电压值（假设参考电压为1.8V）
-    // 12位ADC最大值：4095，ADC的参考电压为：1.8V
-    adc_vol = adc_value * 1800 / 4095; // 单位：mV
+    // 12位ADC最大值：4095(定标值 65520)，ADC的参考电压为：1.8V
+    adc_vol = adc_filter_to_mv(adc_value); // 单位：mV
+    trace_adc12c_convert(DEVICE_NAME, _IOC_NR(cmd), (int)adc_vol);
 
     // 将电压值复制到用户空间
     ret = copy_to_user((void *)arg, &adc_vol, 4);
 
-    if (ret != 0)
+    if (ret != 0) {
+        drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
         return -EFAULT;
+    }
 
     return 0;
 }
@@ -246,4 +463,15 @@ MODULE_VERSION("2025-10-02_V1.0.1");
  * 改动历史纪录：
  * Revision 1.0, 2025-10-02, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: ioctl/read 路径上的 printk 改为 adc12c_convert 跟踪点与 pr_debug，
+ *           增加 debugfs 计数器 /sys/kernel/debug/adc12_cdev/stats.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 转换结束由中断通知，进程睡眠等待，不再忙等 ADCCON[0]；
+ *           电源和预分频在设备打开期间保持，不再每次转换重新配置.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 增加 ADC_IOCTL_SCAN，一次调用依次转换多个通道.
+ * Revision 1.4, 2026-10-17, lium
+ * describe: 增加过采样滤波 ADC_IOCTL_SET_FILTER/GET_FILTER(adc_filter.h)：
+ *           滑动平均、中值和 CIC 抽取，整数定点运算，扫描结果增加 16 位定标值.
  *************************************************************************/
\ No newline at end of file
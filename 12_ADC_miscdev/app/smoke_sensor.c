@@ -8,6 +8,13 @@
  *   生成日期: 2025-10-2
  *   作    者: lium
  *   功    能: 通过片上ADC采集烟雾传感器数据
+ *   用    法: ./zsf12                                  交互输入通道，每秒读一次
+ *             ./zsf12 scan [通道掩码]                    每秒扫描一次多个通道，默认 0xF
+ *             ./zsf12 stream 通道 采样率Hz [秒数]       连续采样，read 批量读取，每秒打印统计
+ *             ./zsf12 mmap 通道 采样率Hz [秒数]         连续采样，mmap 采样队列直接读取
+ *             ./zsf12 alarm 通道掩码 上限mV [下限mV [回差mV]]  报警监视，只在越过门限时醒来打印
+ *             以上各模式前可加 -f 模式,taps[,order[,decimation]] 设置驱动中的滤波，
+ *             模式为 none/mean/median/cic，如 ./zsf12 -f cic,16,3 stream 0 16000
  *
  ************************************************************************/
 #include <stdio.h>
@@ -17,6 +24,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <sys/mman.h>
 
 /**驱动和应用层的命令要一致 */
 #define GEC6818_ADC_IN0   _IOR('A', 0, unsigned long) // 读取通道0的命令
@@ -24,6 +34,373 @@
 #define GEC6818_ADC_IN2   _IOR('A', 2, unsigned long) // 读取通道2的命令
 #define GEC6818_ADC_IN3   _IOR('A', 3, unsigned long) // 读取通道3的命令
 
+/**多通道扫描，与驱动中的定义一致 */
+struct adc_scan {
+    unsigned int mask;
+    unsigned int count;
+    unsigned short raw[4];
+    unsigned short mv[4];
+    unsigned short value[4];        // 16 位定标值 raw << 4
+};
+
+#define ADC_IOCTL_SCAN    _IOWR('A', 4, struct adc_scan)
+
+/**驱动中的过采样滤波，与驱动 adc_filter.h 中的定义一致 */
+struct adc_filter_cfg {
+    unsigned int mode;              // 0 不滤波 1 滑动平均 2 中值 3 CIC
+    unsigned int taps;
+    unsigned int order;
+    unsigned int decimation;
+};
+
+#define ADC_IOCTL_SET_FILTER    _IOW('A', 10, struct adc_filter_cfg)
+#define ADC_IOCTL_GET_FILTER    _IOR('A', 11, struct adc_filter_cfg)
+
+/**
+ * @brief 解析 "模式,taps[,order[,decimation]]" 并设置驱动的滤波
+ * @return 成功返回 0
+ */
+static int filter_set(int fd, const char *arg)
+{
+    static const char *const names[] = { "none", "mean", "median", "cic" };
+    struct adc_filter_cfg cfg;
+    char name[16];
+    unsigned int i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    if (sscanf(arg, "%15[a-z],%u,%u,%u", name, &cfg.taps, &cfg.order, &cfg.decimation) < 1) {
+        printf("Invalid filter: %s\n", arg);
+        return -1;
+    }
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0)
+            break;
+    }
+    if (i == sizeof(names) / sizeof(names[0])) {
+        printf("Invalid filter mode: %s\n", name);
+        return -1;
+    }
+    cfg.mode = i;
+    if (ioctl(fd, ADC_IOCTL_SET_FILTER, &cfg) != 0) {
+        perror("ADC_IOCTL_SET_FILTER");
+        return -1;
+    }
+    ioctl(fd, ADC_IOCTL_GET_FILTER, &cfg);
+    printf("filter %s: taps %u, order %u, decimation %u\n", names[cfg.mode], cfg.taps, cfg.order, cfg.decimation);
+    return 0;
+}
+
+/**
+ * @brief 每秒扫描一次 mask 中的通道并打印
+ */
+static int scan_run(int fd, unsigned int mask)
+{
+    struct adc_scan scan;
+    unsigned int ch;
+    unsigned int i;
+
+    while (1) {
+        scan.mask = mask;
+        if (ioctl(fd, ADC_IOCTL_SCAN, &scan) != 0) {
+            perror("ADC_IOCTL_SCAN");
+            return -1;
+        }
+        for (ch = 0, i = 0; ch < 4; ch++) {
+            if (mask & (1 << ch)) {
+                printf("ch%u %4u mV (%7.2f)  ", ch, scan.mv[i], scan.value[i] / 16.0);
+                i++;
+            }
+        }
+        printf("\n");
+        sleep(1);
+    }
+    return 0;
+}
+
+/**连续采样，与驱动中的定义一致 */
+struct adc_sample {
+    unsigned long long timestamp_ns;
+    unsigned short channel;
+    unsigned short raw;
+    unsigned int value;             // 滤波结果，16 位定标值
+};
+
+struct adc_stream_cfg {
+    unsigned int channel;
+    unsigned int rate_hz;
+    unsigned int watermark;
+};
+
+#define ADC_IOCTL_STREAM_START  _IOW('A', 8, struct adc_stream_cfg)
+#define ADC_IOCTL_STREAM_STOP   _IO('A', 9)
+
+/**mmap 的第 0 页，与驱动中的定义一致 */
+struct adc_ring_ctrl {
+    unsigned int head;
+    unsigned int size;
+    unsigned int data_offset;
+    unsigned int dropped;
+    unsigned int reserved0[12];
+    unsigned int tail;
+    unsigned int reserved1[15];
+};
+
+#define STREAM_BATCH    512         // 一次 read 最多取出的采样数
+
+/**报警监视，与驱动中的定义一致 */
+struct adc_alarm_cfg {
+    unsigned int mask;
+    unsigned int rate_hz;
+    unsigned short high_mv[4];      // 0 不检查
+    unsigned short low_mv[4];       // 0 不检查
+    unsigned short hyst_mv[4];
+};
+
+struct adc_alarm_event {
+    unsigned long long timestamp_ns;
+    unsigned short channel;
+    unsigned short state;           // 0 正常 1 高于上限 2 低于下限
+    unsigned short prev;            // 0xFFFF 表示监视开始后的第一个结果
+    unsigned short mv;
+};
+
+#define ADC_IOCTL_ALARM_START   _IOW('A', 12, struct adc_alarm_cfg)
+#define ADC_IOCTL_ALARM_STOP    _IO('A', 13)
+
+#define ALARM_RATE_HZ   100         // 后台转换速率，多个通道轮流
+
+/**
+ * @brief 报警监视，进程在 poll 中睡眠，只有状态变化时才醒来
+ */
+static int alarm_run(int fd, unsigned int mask, unsigned int high_mv, unsigned int low_mv, unsigned int hyst_mv)
+{
+    static const char *const states[] = { "normal", "HIGH", "LOW" };
+    struct adc_alarm_event ev[16];
+    struct adc_alarm_cfg cfg;
+    struct pollfd pfd;
+    unsigned int ch;
+    ssize_t n;
+    int i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.mask = mask;
+    cfg.rate_hz = ALARM_RATE_HZ;
+    for (ch = 0; ch < 4; ch++) {
+        cfg.high_mv[ch] = high_mv;
+        cfg.low_mv[ch] = low_mv;
+        cfg.hyst_mv[ch] = hyst_mv;
+    }
+    if (ioctl(fd, ADC_IOCTL_ALARM_START, &cfg) != 0) {
+        perror("ADC_IOCTL_ALARM_START");
+        return -1;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (1) {
+        if (poll(&pfd, 1, -1) < 0) {
+            perror("poll");
+            break;
+        }
+        n = read(fd, ev, sizeof(ev));
+        if (n < 0) {
+            perror("read");
+            break;
+        }
+        for (i = 0; i < (int)(n / sizeof(ev[0])); i++) {
+            printf("[%llu.%03llu] ch%u %4u mV: %s -> %s\n",
+                   ev[i].timestamp_ns / 1000000000ULL, ev[i].timestamp_ns / 1000000ULL % 1000,
+                   ev[i].channel, ev[i].mv, ev[i].prev < 3 ? states[ev[i].prev] : "start",
+                   ev[i].state < 3 ? states[ev[i].state] : "?");
+        }
+    }
+
+    ioctl(fd, ADC_IOCTL_ALARM_STOP);
+    return 0;
+}
+
+/**每秒的统计 */
+typedef struct TStreamStats_t {
+    unsigned int channel;
+    unsigned long long period_ns;
+    unsigned long long window_start;
+    unsigned long long last_ts;
+    unsigned long long sum;
+    unsigned int count;
+    unsigned int missed;
+    unsigned int calls;             // read 或 poll 的次数
+    unsigned int min;
+    unsigned int max;
+    unsigned int elapsed;           // 已打印的秒数
+} TStreamStats_t;
+
+static void stats_reset(TStreamStats_t *st)
+{
+    st->sum = 0;
+    st->count = 0;
+    st->missed = 0;
+    st->calls = 0;
+    st->min = 0xFFFF;
+    st->max = 0;
+}
+
+/**
+ * @brief 统计一个采样，满一秒时打印采样数、电压的最小/平均/最大值和缺失的采样数
+ */
+static void stats_add(TStreamStats_t *st, const struct adc_sample *sample)
+{
+    unsigned int mv;
+
+    if (st->window_start == 0)
+        st->window_start = sample->timestamp_ns;
+    if (st->last_ts != 0 && sample->timestamp_ns - st->last_ts > st->period_ns * 3 / 2)
+        st->missed += (unsigned int)((sample->timestamp_ns - st->last_ts) / st->period_ns) - 1;
+    st->last_ts = sample->timestamp_ns;
+
+    mv = sample->value * 1800 / 65520;
+    st->sum += mv;
+    st->count++;
+    if (mv < st->min)
+        st->min = mv;
+    if (mv > st->max)
+        st->max = mv;
+
+    if (sample->timestamp_ns - st->window_start >= 1000000000ULL) {
+        printf("ch%u: %u samples in %u calls, min %u avg %llu max %u mV, missed %u\n",
+               st->channel, st->count, st->calls, st->min, st->sum / st->count, st->max, st->missed);
+        st->window_start = sample->timestamp_ns;
+        st->elapsed++;
+        stats_reset(st);
+    }
+}
+
+/**
+ * @brief 开始连续采样
+ * @return 成功返回 0
+ */
+static int stream_start(int fd, TStreamStats_t *st, unsigned int channel, unsigned int rate_hz)
+{
+    struct adc_stream_cfg cfg;
+    struct adc_filter_cfg fcfg;
+
+    if (rate_hz == 0) {
+        printf("Invalid rate!\n");
+        return -1;
+    }
+    // 滤波时每 decimation 个转换得到一个采样
+    if (ioctl(fd, ADC_IOCTL_GET_FILTER, &fcfg) != 0 || fcfg.decimation == 0)
+        fcfg.decimation = 1;
+    memset(st, 0, sizeof(*st));
+    st->channel = channel;
+    st->period_ns = 1000000000ULL * fcfg.decimation / rate_hz;
+    stats_reset(st);
+
+    cfg.channel = channel;
+    cfg.rate_hz = rate_hz;
+    cfg.watermark = rate_hz / fcfg.decimation / 10;     // 每秒约唤醒 10 次
+    if (ioctl(fd, ADC_IOCTL_STREAM_START, &cfg) != 0) {
+        perror("ADC_IOCTL_STREAM_START");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 连续采样，read 批量复制
+ * @param seconds 采样时长，0 表示一直采样
+ */
+static int stream_run(int fd, unsigned int channel, unsigned int rate_hz, unsigned int seconds)
+{
+    static struct adc_sample buf[STREAM_BATCH];
+    TStreamStats_t st;
+    ssize_t n;
+    int i;
+
+    if (stream_start(fd, &st, channel, rate_hz) != 0)
+        return -1;
+
+    while (seconds == 0 || st.elapsed < seconds) {
+        n = read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            perror("read");
+            break;
+        }
+        if (n == 0)
+            break;
+        st.calls++;
+        for (i = 0; i < (int)(n / sizeof(buf[0])); i++)
+            stats_add(&st, &buf[i]);
+    }
+
+    ioctl(fd, ADC_IOCTL_STREAM_STOP);
+    return 0;
+}
+
+/**
+ * @brief 连续采样，mmap 采样队列，直接在映射区中处理，队列空时才 poll
+ */
+static int stream_mmap_run(int fd, unsigned int channel, unsigned int rate_hz, unsigned int seconds)
+{
+    volatile struct adc_ring_ctrl *ctrl;
+    const struct adc_sample *data;
+    struct pollfd pfd;
+    TStreamStats_t st;
+    unsigned int head;
+    unsigned int tail;
+    size_t len;
+    void *mem;
+
+    // 先映射控制页得到采样数组的大小，再映射整个队列
+    mem = mmap(NULL, sizeof(struct adc_ring_ctrl), PROT_READ, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    ctrl = mem;
+    len = ctrl->data_offset + ctrl->size * sizeof(struct adc_sample);
+    munmap(mem, sizeof(struct adc_ring_ctrl));
+
+    mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    ctrl = mem;
+    data = (const struct adc_sample *)((char *)mem + ctrl->data_offset);
+
+    if (stream_start(fd, &st, channel, rate_hz) != 0) {
+        munmap(mem, len);
+        return -1;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (seconds == 0 || st.elapsed < seconds) {
+        head = ctrl->head;
+        tail = ctrl->tail;
+        if (head == tail) {
+            st.calls++;
+            if (poll(&pfd, 1, 1000) < 0) {
+                perror("poll");
+                break;
+            }
+            continue;
+        }
+        __sync_synchronize();       // 先读 head，再读采样
+        while (tail != head) {
+            stats_add(&st, &data[tail & (ctrl->size - 1)]);
+            tail++;
+        }
+        __sync_synchronize();       // 采样处理完，再释放空间
+        ctrl->tail = tail;
+    }
+
+    ioctl(fd, ADC_IOCTL_STREAM_STOP);
+    printf("dropped %u\n", ctrl->dropped);
+    munmap(mem, len);
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     int fd = -1;
@@ -39,6 +416,41 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (argc >= 3 && strcmp(argv[1], "-f") == 0) {
+        if (filter_set(fd, argv[2]) != 0) {
+            close(fd);
+            return -1;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "scan") == 0) {
+        ret = scan_run(fd, argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 0) : 0xF);
+        close(fd);
+        return ret;
+    }
+    if (argc >= 4 && strcmp(argv[1], "stream") == 0) {
+        ret = stream_run(fd, (unsigned int)atoi(argv[2]), (unsigned int)atoi(argv[3]),
+                         argc > 4 ? (unsigned int)atoi(argv[4]) : 0);
+        close(fd);
+        return ret;
+    }
+    if (argc >= 4 && strcmp(argv[1], "alarm") == 0) {
+        ret = alarm_run(fd, (unsigned int)strtoul(argv[2], NULL, 0), (unsigned int)atoi(argv[3]),
+                        argc > 4 ? (unsigned int)atoi(argv[4]) : 0,
+                        argc > 5 ? (unsigned int)atoi(argv[5]) : 20);
+        close(fd);
+        return ret;
+    }
+    if (argc >= 4 && strcmp(argv[1], "mmap") == 0) {
+        ret = stream_mmap_run(fd, (unsigned int)atoi(argv[2]), (unsigned int)atoi(argv[3]),
+                              argc > 4 ? (unsigned int)atoi(argv[4]) : 0);
+        close(fd);
+        return ret;
+    }
+
     // 提示用户输入通道号
     printf("1. Please input the channel (0, 1, 2, 3...): ");
     scanf("%d", &channel);
@@ -86,4 +498,14 @@ int main(int argc, char **argv)
  * 改动历史纪录：
  * Revision 1.0, 2025-10-02, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 增加 stream 模式，使用驱动的连续采样批量读取.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 增加 mmap 模式，直接读取映射的采样队列.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 增加 scan 模式，一次 ioctl 读取多个通道.
+ * Revision 1.4, 2026-10-17, lium
+ * describe: 增加 -f 选项设置驱动中的过采样滤波，采样点和扫描结果使用 16 位定标值.
+ * Revision 1.5, 2026-10-17, lium
+ * describe: 增加 alarm 模式，使用驱动的报警监视代替每秒轮询.
  *************************************************************************/
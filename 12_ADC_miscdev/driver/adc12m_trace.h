@@ -0,0 +1,72 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: adc12m_trace.h
+ *   软件模块: 跟踪点
+ *   功    能: ADC 杂项设备驱动的 tracepoint，字段统一为 dev/pin/value/ts，
+ *             ts 为 CLOCK_MONOTONIC 纳秒，可直接与应用层的时间对齐。
+ *             默认关闭，几乎没有开销；需要时：
+ *             echo 1 > /sys/kernel/debug/tracing/events/adc12m/enable
+ *             cat /sys/kernel/debug/tracing/trace_pipe
+ *             或 perf record -e 'adc12m:*'
+ *
+ ************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM adc12m
+
+#if !defined(ADC12M_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define ADC12M_TRACE_H_
+
+#include <linux/tracepoint.h>
+#include <linux/ktime.h>
+
+/**
+ * dev   设备名
+ * pin   ADC 通道号
+ * value 转换结果(mV)
+ */
+DECLARE_EVENT_CLASS(adc12m_pin_class,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value),
+    TP_STRUCT__entry(
+        __string(dev, dev)
+        __field(int, pin)
+        __field(int, value)
+        __field(u64, ts)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev);
+        __entry->pin = pin;
+        __entry->value = value;
+        __entry->ts = ktime_to_ns(ktime_get());
+    ),
+    TP_printk("dev=%s pin=%d value=%d ts=%llu",
+              __get_str(dev), __entry->pin, __entry->value,
+              (unsigned long long)__entry->ts)
+);
+
+/**每次转换完成一个事件 */
+DEFINE_EVENT(adc12m_pin_class, adc12m_convert,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+/**连续采样模式下每次 read 一个事件，value 为取出的采样数 */
+DEFINE_EVENT(adc12m_pin_class, adc12m_stream_read,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+/**报警监视的状态变化一个事件，value 为触发变化的电压(mV) */
+DEFINE_EVENT(adc12m_pin_class, adc12m_alarm,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+#endif  /* ADC12M_TRACE_H_ */
+
+/* 跟踪头文件在驱动目录下，Makefile 中需要 CFLAGS_xxx.o := -I$(src) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE adc12m_trace
+#include <trace/define_trace.h>
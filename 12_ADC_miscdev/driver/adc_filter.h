@@ -0,0 +1,198 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: adc_filter.h
+ *   软件模块: ADC 滤波
+ *   功    能: 对 12 位原始值做过采样滤波，只用整数运算，可在中断中调用。
+ *             输出统一为 16 位定标值 value = raw << 4，多出的 4 位是平均得到的
+ *             小数部分，电压(uV) = value * 2500 / 91(即 value * 1800000 / 65520)。
+ *             ADC_FILTER_MEAN   最近 taps 个采样的滑动平均，运行和，O(1)；
+ *             ADC_FILTER_MEDIAN 最近 taps 个采样的中值(taps 为奇数)，去除尖峰；
+ *             ADC_FILTER_CIC    order 阶 CIC 抽取滤波器，抽取比 taps(2 的幂)，
+ *                               积分器按 32 位回绕运算，要求 12 + order*log2(taps) <= 32。
+ *             MEAN/MEDIAN 每 decimation 个输入输出一个，CIC 每 taps 个输入输出一个。
+ *
+ ************************************************************************/
+#ifndef ADC_FILTER_H_
+#define ADC_FILTER_H_
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/log2.h>
+#include <linux/string.h>      // memset
+
+#define ADC_FILTER_NONE         0       // 不滤波，每个采样输出一个
+#define ADC_FILTER_MEAN         1
+#define ADC_FILTER_MEDIAN       2
+#define ADC_FILTER_CIC          3
+
+#define ADC_FILTER_MAX_TAPS     64
+#define ADC_FILTER_MAX_MEDIAN   15      // 中值每次输出要排序，窗口不宜过大
+#define ADC_FILTER_MAX_ORDER    4
+#define ADC_FILTER_MAX_SHIFT    20      // CIC 的位增长 order*log2(taps) 上限
+#define ADC_FILTER_FRAC_BITS    4       // 输出比原始值多的小数位
+
+/**滤波参数，ADC_IOCTL_SET_FILTER 的参数 */
+struct adc_filter_cfg {
+    unsigned int mode;                  // ADC_FILTER_*
+    unsigned int taps;                  // MEAN/MEDIAN 的窗口长度，CIC 的抽取比
+    unsigned int order;                 // CIC 的阶数 1~4，其他模式忽略
+    unsigned int decimation;            // MEAN/MEDIAN 每几个输入输出一个，1 ~ taps，0 表示等于 taps
+};
+
+/**滤波状态，每个独立的采样序列一个 */
+struct adc_filter {
+    struct adc_filter_cfg cfg;
+    unsigned int shift;                 // CIC 的位增长 order*log2(taps)
+    unsigned int pos;                   // 窗口中下一个写入位置
+    unsigned int fill;                  // 窗口中的有效采样数
+    unsigned int phase;                 // 距上一次输出的输入数
+    u32 sum;                            // MEAN 的运行和
+    u32 integ[ADC_FILTER_MAX_ORDER];    // CIC 各级积分器
+    u32 comb[ADC_FILTER_MAX_ORDER];     // CIC 各级梳状滤波器上一次抽取时的输入
+    u16 hist[ADC_FILTER_MAX_TAPS];      // MEAN/MEDIAN 的窗口
+};
+
+/**
+ * @brief 检查参数并补全默认值
+ * @return 合法返回 0，否则返回 -EINVAL
+ */
+static inline int adc_filter_check(struct adc_filter_cfg *cfg)
+{
+    switch (cfg->mode) {
+        case ADC_FILTER_NONE:
+            cfg->taps = 1;
+            cfg->order = 1;
+            cfg->decimation = 1;
+            return 0;
+        case ADC_FILTER_MEAN:
+        case ADC_FILTER_MEDIAN:
+            if (cfg->taps == 0 || cfg->taps > ADC_FILTER_MAX_TAPS)
+                return -EINVAL;
+            if (cfg->mode == ADC_FILTER_MEDIAN && (cfg->taps > ADC_FILTER_MAX_MEDIAN || !(cfg->taps & 1)))
+                return -EINVAL;
+            if (cfg->decimation == 0)
+                cfg->decimation = cfg->taps;
+            if (cfg->decimation > cfg->taps)
+                return -EINVAL;         // 否则 adc_filter_burst() 个输入内没有输出
+            cfg->order = 1;
+            return 0;
+        case ADC_FILTER_CIC:
+            if (cfg->taps < 2 || cfg->taps > ADC_FILTER_MAX_TAPS || !is_power_of_2(cfg->taps))
+                return -EINVAL;
+            if (cfg->order == 0 || cfg->order > ADC_FILTER_MAX_ORDER ||
+                cfg->order * ilog2(cfg->taps) > ADC_FILTER_MAX_SHIFT)
+                return -EINVAL;
+            cfg->decimation = cfg->taps;
+            return 0;
+        default:
+            return -EINVAL;
+    }
+}
+
+/**
+ * @brief 清空状态，cfg 须已通过 adc_filter_check()
+ */
+static inline void adc_filter_reset(struct adc_filter *f, const struct adc_filter_cfg *cfg)
+{
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    if (cfg->mode == ADC_FILTER_CIC)
+        f->shift = cfg->order * ilog2(cfg->taps);
+}
+
+/**
+ * @brief 从清空的状态开始，得到第一个完整的输出需要的输入数
+ *        CIC 的冲激响应长 order*(taps-1)+1，第 order 个输出才不含初始的 0
+ */
+static inline unsigned int adc_filter_burst(const struct adc_filter_cfg *cfg)
+{
+    return cfg->mode == ADC_FILTER_CIC ? cfg->taps * cfg->order : cfg->taps;
+}
+
+static inline unsigned int adc_filter_median(const struct adc_filter *f)
+{
+    u16 tmp[ADC_FILTER_MAX_MEDIAN];
+    unsigned int n = f->cfg.taps;
+    unsigned int i;
+    unsigned int j;
+    u16 v;
+
+    // 插入排序，窗口最多 15 个
+    for (i = 0; i < n; i++) {
+        v = f->hist[i];
+        for (j = i; j > 0 && tmp[j - 1] > v; j--)
+            tmp[j] = tmp[j - 1];
+        tmp[j] = v;
+    }
+    return tmp[n / 2];
+}
+
+/**
+ * @brief 送入一个 12 位原始值
+ * @param value 有输出时填入 16 位定标值
+ * @return 有输出返回 1，否则返回 0
+ */
+static inline int adc_filter_push(struct adc_filter *f, unsigned int raw, unsigned int *value)
+{
+    unsigned int taps = f->cfg.taps;
+    unsigned int i;
+    u32 y;
+    u32 t;
+
+    switch (f->cfg.mode) {
+        case ADC_FILTER_MEAN:
+        case ADC_FILTER_MEDIAN:
+            f->sum += raw - f->hist[f->pos];
+            f->hist[f->pos] = raw;
+            f->pos = (f->pos + 1 == taps) ? 0 : f->pos + 1;
+            if (f->fill < taps)
+                f->fill++;
+            f->phase++;
+            if (f->fill < taps || f->phase < f->cfg.decimation)
+                return 0;
+            f->phase = 0;
+            if (f->cfg.mode == ADC_FILTER_MEAN)
+                *value = ((f->sum << ADC_FILTER_FRAC_BITS) + taps / 2) / taps;
+            else
+                *value = adc_filter_median(f) << ADC_FILTER_FRAC_BITS;
+            return 1;
+
+        case ADC_FILTER_CIC:
+            f->integ[0] += raw;
+            for (i = 1; i < f->cfg.order; i++)
+                f->integ[i] += f->integ[i - 1];
+            if (++f->phase < taps)
+                return 0;
+            f->phase = 0;
+
+            y = f->integ[f->cfg.order - 1];
+            for (i = 0; i < f->cfg.order; i++) {
+                t = y;
+                y -= f->comb[i];
+                f->comb[i] = t;
+            }
+            // 增益 taps^order = 2^shift，归一化到 16 位定标值
+            if (f->shift >= ADC_FILTER_FRAC_BITS)
+                *value = (y + (1U << (f->shift - ADC_FILTER_FRAC_BITS) >> 1)) >> (f->shift - ADC_FILTER_FRAC_BITS);
+            else
+                *value = y << (ADC_FILTER_FRAC_BITS - f->shift);
+            return 1;
+
+        default:
+            *value = raw << ADC_FILTER_FRAC_BITS;
+            return 1;
+    }
+}
+
+/**16 位定标值换算为电压 */
+static inline unsigned int adc_filter_to_mv(unsigned int value)
+{
+    return (value * 1800 + 65520 / 2) / 65520;
+}
+
+static inline unsigned int adc_filter_to_uv(unsigned int value)
+{
+    return value * 2500 / 91;
+}
+
+#endif  /* ADC_FILTER_H_ */
@@ -8,6 +8,20 @@
  *   生成日期: 2025-10-2
  *   作    者: lium
  *   功    能: 通过片上ADC采集烟雾传感器数据
+ *             1. ioctl(GEC6818_ADC_INx) 单次转换，返回电压(mV)；
+ *             2. ioctl(ADC_IOCTL_SCAN) 一次调用依次转换多个通道；
+ *             3. ioctl(ADC_IOCTL_STREAM_START) 连续采样：hrtimer 按采样率启动转换，
+ *                转换结束中断把 {时间戳, 通道, 原始值} 放入环形队列，
+ *                队列中达到 watermark 个采样时唤醒 read/poll；
+ *             4. 环形队列可以 mmap 到用户空间：第 0 页是 struct adc_ring_ctrl，
+ *                之后是采样数组，消费者直接读采样、更新 tail，队列空时才 poll，
+ *                read 是同一个队列的另一种取法(复制)，两者不要同时使用；
+ *             5. ioctl(ADC_IOCTL_SET_FILTER) 在内核中做过采样滤波(滑动平均/中值/CIC 抽取)，
+ *                单次转换和扫描每个结果转换 adc_filter_burst() 次，连续采样时每
+ *                decimation 个转换放入一个采样，结果带 4 位小数(16 位定标值)；
+ *             6. ioctl(ADC_IOCTL_ALARM_START) 报警监视：后台按 rate_hz 轮流转换 mask 中的通道，
+ *                (滤波后的)电压越过上/下限时才放入一个 struct adc_alarm_event 并唤醒
+ *                read/poll，回差避免在门限附近反复报警；与连续采样互斥.
  *
  ************************************************************************/
 
@@ -19,6 +33,23 @@
 #include <linux/miscdevice.h>       // 杂项字符设备
 #include <linux/ioctl.h>            // ioctl
 #include <linux/ioport.h>           // request_mem_region
+#include <linux/interrupt.h>        // request_irq
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/hrtimer.h>          // 连续采样的节拍
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>          // vmalloc_user，可映射到用户空间的采样队列
+#include <linux/mm.h>               // remap_vmalloc_range
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/kfifo.h>            // 报警事件队列
+#include <linux/delay.h>            // udelay
+#include <mach/platform.h>          // IRQ_PHY_ADC
+
+#include "drv_stats.h"
+#include "adc_filter.h"
+#define CREATE_TRACE_POINTS
+#include "adc12m_trace.h"
 
 #define DEVICE_NAME     "adc"   // /dev/adc
 
@@ -30,16 +61,174 @@
 #define GEC6818_ADC_IN2   _IOR('A', 2, unsigned long)       // ADC通道2
 #define GEC6818_ADC_IN3   _IOR('A', 3, unsigned long)       // ADC通道3
 
+/**多通道扫描：依次转换 mask 中的通道，结果按通道号从小到大紧凑排列 */
+#define ADC_CHANNELS            4
+
+struct adc_scan {
+    unsigned int mask;                  // 输入：bit n 为 1 表示转换通道 n
+    unsigned int count;                 // 输出：转换的通道数
+    unsigned short raw[ADC_CHANNELS];   // 输出：12 位值，滤波时为滤波结果四舍五入
+    unsigned short mv[ADC_CHANNELS];    // 输出：电压(mV)
+    unsigned short value[ADC_CHANNELS]; // 输出：16 位定标值 raw << 4，滤波时低 4 位有效
+};
+
+#define ADC_IOCTL_SCAN    _IOWR('A', 4, struct adc_scan)
+
+/**
+ * 连续采样的一个采样点，read 每次返回整数个，count 小于一个时返回 -EINVAL。
+ */
+struct adc_sample {
+    unsigned long long timestamp_ns;    // 启动转换的时刻，CLOCK_MONOTONIC
+    unsigned short channel;             // 通道 0~3
+    unsigned short raw;                 // 最后一个转换的 12 位原始值
+    unsigned int value;                 // 滤波结果，16 位定标值，电压(mV) = value * 1800 / 65520
+};
+
+/**连续采样参数 */
+struct adc_stream_cfg {
+    unsigned int channel;               // 通道 0~3
+    unsigned int rate_hz;               // 采样率 1 ~ ADC_STREAM_MAX_HZ
+    unsigned int watermark;             // 队列中至少有这么多采样时才唤醒读者，0 视为 1
+};
+
+#define ADC_IOCTL_STREAM_START  _IOW('A', 8, struct adc_stream_cfg)    // 开始连续采样，清空队列
+#define ADC_IOCTL_STREAM_STOP   _IO('A', 9)                             // 停止，队列中剩余的采样仍可读出
+
+/**
+ * 报警监视：每个通道独立的窗口比较器，上限/下限为 0 表示不检查该侧。
+ * 电压 >= high_mv 进入 ADC_ALARM_HIGH，降到 high_mv - hyst_mv 以下才回到 ADC_ALARM_NORMAL；
+ * 电压 <= low_mv 进入 ADC_ALARM_LOW，升到 low_mv + hyst_mv 以上才回到 ADC_ALARM_NORMAL。
+ * 同时检查两侧时须 low_mv + hyst_mv < high_mv - hyst_mv。
+ */
+struct adc_alarm_cfg {
+    unsigned int mask;                          // bit n 为 1 表示监视通道 n
+    unsigned int rate_hz;                       // 转换速率，多个通道轮流，1 ~ ADC_STREAM_MAX_HZ
+    unsigned short high_mv[ADC_CHANNELS];       // 上限(mV)
+    unsigned short low_mv[ADC_CHANNELS];        // 下限(mV)
+    unsigned short hyst_mv[ADC_CHANNELS];       // 回差(mV)
+};
+
+#define ADC_ALARM_NORMAL        0
+#define ADC_ALARM_HIGH          1
+#define ADC_ALARM_LOW           2
+#define ADC_ALARM_UNKNOWN       0xFFFF          // 开始监视后还没有结果
+
+/**
+ * 一次状态变化，read 每次返回整数个；每个通道的第一个结果也产生一个事件(prev 为
+ * ADC_ALARM_UNKNOWN)，报告初始状态。
+ */
+struct adc_alarm_event {
+    unsigned long long timestamp_ns;    // 启动转换的时刻，CLOCK_MONOTONIC
+    unsigned short channel;
+    unsigned short state;               // ADC_ALARM_*
+    unsigned short prev;                // 变化前的状态
+    unsigned short mv;                  // 触发变化的电压(mV)
+};
+
+#define ADC_IOCTL_ALARM_START   _IOW('A', 12, struct adc_alarm_cfg)    // 开始监视，清空事件队列
+#define ADC_IOCTL_ALARM_STOP    _IO('A', 13)                            // 停止，队列中剩余的事件仍可读出
+
+/**滤波参数见 adc_filter.h，对之后的单次转换、扫描和连续采样生效，连续采样中设置返回 -EBUSY */
+#define ADC_IOCTL_SET_FILTER    _IOW('A', 10, struct adc_filter_cfg)
+#define ADC_IOCTL_GET_FILTER    _IOR('A', 11, struct adc_filter_cfg)    // 取得补全了默认值的参数
+
+/**
+ * mmap 的第 0 页，之后 data_offset 处是 size 个 struct adc_sample。
+ * head/tail 只增不减，下标为 head % size；head - tail 为队列中的采样数。
+ * 内核写采样后再更新 head，消费者读完采样后再更新 tail，
+ * head 和 tail 分在两个 cache line，生产者和消费者不互相争用。
+ */
+struct adc_ring_ctrl {
+    unsigned int head;                  // 内核写：下一个写入位置
+    unsigned int size;                  // 采样数组的容量，2 的幂
+    unsigned int data_offset;           // 采样数组在映射区中的偏移(字节)
+    unsigned int dropped;               // 队列满丢弃的采样累计数
+    unsigned int reserved0[12];
+    unsigned int tail;                  // 消费者写：下一个读取位置
+    unsigned int reserved1[15];
+};
+
 /**物理地址转换为虚拟地址，用于保存ADC的虚拟地址 */
 static void __iomem *adc_base_va;                           // adc的虚拟地址基址
 static void __iomem *adcon_va;
 static void __iomem *adcdat_va;
+static void __iomem *adcintenb_va;
+static void __iomem *adcintclr_va;
 static void __iomem *prescalercon_va;
 
+/**ADC 中断 */
+#define ADC_PRESCALER           199                         // ADC 工作频率 = 200MHz / (199+1) = 1MHz
+#define ADC_CONVERT_TIMEOUT_MS  10                          // 一次转换约 5us，超时说明中断没有到来
+
+static DEFINE_MUTEX(adc_mutex);                             // 一次只进行一个转换，同时保护 adc_users
+static DECLARE_COMPLETION(adc_done);                        // 转换结束，由中断通知
+static int adc_busy;                                        // 为 1 时本驱动在等待转换结束
+static int adc_users;                                       // 打开的次数，> 0 时 ADC 保持上电
+static struct adc_filter_cfg adc_filter_conf = {            // 由 adc_mutex 保护，默认不滤波
+    .mode = ADC_FILTER_NONE, .taps = 1, .order = 1, .decimation = 1,
+};
+
+static irqreturn_t adc_irq_handler(int irq, void *dev_id);
+static enum hrtimer_restart adc_stream_timer_fn(struct hrtimer *timer);
+
+/**连续采样 */
+#define ADC_STREAM_MAX_HZ       20000       // 一次转换约 5us，另留出两次中断的处理时间
+#define ADC_RING_SIZE           4096        // 采样队列容量，须为 2 的幂，20kHz 下约 200ms
+#define ADC_RING_BYTES          (PAGE_SIZE + ADC_RING_SIZE * sizeof(struct adc_sample))
+
+static void *adc_ring_mem;                  // vmalloc_user，控制页 + 采样数组
+static struct adc_ring_ctrl *adc_ring;
+static struct adc_sample *adc_ring_data;
+static DECLARE_WAIT_QUEUE_HEAD(adc_waitq);
+static DEFINE_MUTEX(adc_read_lock);         // 多个 read 之间串行
+static struct hrtimer adc_stream_timer;
+static ktime_t adc_stream_period;
+static int adc_streaming;                   // 由 adc_mutex 保护修改，中断中只读
+static unsigned int adc_stream_channel;     // 报警监视时为正在转换的通道
+static unsigned int adc_stream_watermark = 1;
+static u64 adc_stream_ts;                   // 正在进行的转换的启动时刻
+static unsigned int adc_stream_stall;       // 上一次转换未结束时到来的连续节拍数，只在节拍中使用
+static unsigned int adc_stream_stall_max;   // 超过它认为转换结束中断丢失，约 ADC_CONVERT_TIMEOUT_MS
+static struct adc_filter adc_stream_filter; // 只在中断中使用，开始采样时清空
+
+/**报警监视，定时器和中断与连续采样共用 */
+#define ADC_ALARM_FIFO_SIZE     64          // 事件只在状态变化时产生，不需要很大
+
+struct adc_alarm_chan {
+    struct adc_filter filter;
+    unsigned int high_mv;
+    unsigned int low_mv;
+    unsigned int hyst_mv;
+    unsigned int state;                     // ADC_ALARM_*
+};
+
+static int adc_alarming;                    // 由 adc_mutex 保护修改，中断中只读
+static unsigned int adc_alarm_mask;
+static struct adc_alarm_chan adc_alarm_chans[ADC_CHANNELS];
+static DECLARE_KFIFO(adc_alarm_fifo, struct adc_alarm_event, ADC_ALARM_FIFO_SIZE);
+
+/**debugfs 计数器：/sys/kernel/debug/adc12_misc/stats */
+enum {
+    ADC_STAT_CONVERSIONS = 0,
+    ADC_STAT_ERRORS,
+    ADC_STAT_SAMPLES,                       // 连续采样放入队列的采样数
+    ADC_STAT_DROPPED,                       // 队列满丢弃的采样数
+    ADC_STAT_OVERRUNS,                      // 节拍到来时上一次转换未结束、或节拍被推迟而少采的次数
+    ADC_STAT_ALARMS,                        // 放入队列的报警事件数
+    ADC_STAT_ALARM_DROPPED,                 // 事件队列满丢弃的报警事件数
+    ADC_STAT_NUM
+};
+static const char *const adc_stat_names[ADC_STAT_NUM] = {
+    "conversions", "errors", "samples", "dropped", "overruns", "alarms", "alarm_dropped"
+};
+static struct drv_stats adc_stats;
+
 static int adc_open(struct inode *inode, struct file *pFile);
 static int adc_close(struct inode *inode, struct file *pFile);
 static long adc_ioctl(struct file *pFile, unsigned int cmd, unsigned long arg);
 static ssize_t adc_read(struct file *pFile, char __user *buf, size_t count, loff_t *ppos);
+static unsigned int adc_poll(struct file *pFile, struct poll_table_struct *wait);
+static int adc_mmap(struct file *pFile, struct vm_area_struct *vma);
 
 /**文件操作集 */
 static const struct file_operations adc_fops = {
@@ -47,6 +236,8 @@ static const struct file_operations adc_fops = {
     .open       = adc_open,
     .release    = adc_close,
     .read       = adc_read,
+    .poll       = adc_poll,
+    .mmap       = adc_mmap,
     .unlocked_ioctl      = adc_ioctl,
 };
 
@@ -86,118 +277,694 @@ static int __init adcInit(void)
     // 根据偏移计算寄存器地址
     adcon_va       = adc_base_va + 0x00;
     adcdat_va      = adc_base_va + 0x04;
-
+    adcintenb_va   = adc_base_va + 0x08;
+    adcintclr_va   = adc_base_va + 0x0C;
     prescalercon_va= adc_base_va + 0x10;
 
+    /**4. 采样队列，模块加载期间一直存在，映射不随开始/停止采样失效 */
+    adc_ring_mem = vmalloc_user(ADC_RING_BYTES);
+    if (!adc_ring_mem) {
+        ret = -ENOMEM;
+        goto err_ring;
+    }
+    adc_ring = adc_ring_mem;
+    adc_ring_data = adc_ring_mem + PAGE_SIZE;
+    adc_ring->size = ADC_RING_SIZE;
+    adc_ring->data_offset = PAGE_SIZE;
+
+    hrtimer_init(&adc_stream_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    adc_stream_timer.function = adc_stream_timer_fn;
+    INIT_KFIFO(adc_alarm_fifo);
+
+    /**5. 转换结束中断 */
+    ret = request_irq(IRQ_PHY_ADC, adc_irq_handler, IRQF_SHARED, DEVICE_NAME, &adc_done);
+    if (ret != 0) {
+        printk(KERN_ERR "request_irq %d failed\n", IRQ_PHY_ADC);
+        goto err_request_irq;
+    }
+
+    drv_stats_init(&adc_stats, "adc12_misc", adc_stat_names, ADC_STAT_NUM);
     printk(KERN_INFO "adc driver init success\n");
     return 0;
 
+err_request_irq:
+    vfree(adc_ring_mem);
+err_ring:
+    iounmap(adc_base_va);
 err_ioremap:
-    release_mem_region(GEC6818_ADC_PHY_ADDR, GPIO_MAP_SIZE);
 // err_mem_region:
-//     misc_deregister(&mis_dev);
+    misc_deregister(&mis_dev);
     return ret;
 }
 
 static void __exit adcExit(void)
 {
+    drv_stats_exit(&adc_stats);
+    free_irq(IRQ_PHY_ADC, &adc_done);
+    vfree(adc_ring_mem);
     iounmap(adc_base_va);
-    release_mem_region(GEC6818_ADC_PHY_ADDR, GPIO_MAP_SIZE);
     misc_deregister(&mis_dev);
     printk(KERN_INFO "adc driver exit\n");
 }
 
+/**-------- ADC 上电/转换 -------- */
+/**
+ * @brief 队列中的采样达到 watermark，或已停止采样而队列中还有剩余
+ */
+static int adc_stream_ready(void)
+{
+    unsigned int len = ACCESS_ONCE(adc_ring->head) - ACCESS_ONCE(adc_ring->tail);
+
+    return len >= ACCESS_ONCE(adc_stream_watermark) || (len > 0 && !ACCESS_ONCE(adc_streaming));
+}
+
+/**
+ * @brief 放入一个采样，只在中断中调用(单生产者)；tail 由用户空间写，不可信，
+ *        head - tail 超过容量时按满处理
+ * @return 成功返回 0，队列满返回 -1
+ */
+static int adc_ring_put(const struct adc_sample *sample)
+{
+    unsigned int head = adc_ring->head;
+
+    if (head - ACCESS_ONCE(adc_ring->tail) >= ADC_RING_SIZE) {
+        adc_ring->dropped++;
+        return -1;
+    }
+    adc_ring_data[head & (ADC_RING_SIZE - 1)] = *sample;
+    smp_wmb();                      // 先写采样，再发布 head
+    adc_ring->head = head + 1;
+    return 0;
+}
+
+/**
+ * @brief 报警监视的一个转换结果，只在中断中调用；状态变化时放入事件并唤醒读者
+ */
+static void adc_alarm_sample(unsigned int channel, unsigned int raw)
+{
+    struct adc_alarm_chan *chan = &adc_alarm_chans[channel];
+    struct adc_alarm_event ev;
+    unsigned int value;
+    unsigned int mv;
+    unsigned int state;
+
+    if (!adc_filter_push(&chan->filter, raw, &value))
+        return;
+    mv = adc_filter_to_mv(value);
+
+    state = chan->state;
+    if (chan->high_mv && mv >= chan->high_mv)
+        state = ADC_ALARM_HIGH;
+    else if (chan->low_mv && mv <= chan->low_mv)
+        state = ADC_ALARM_LOW;
+    else if (state == ADC_ALARM_UNKNOWN ||
+             (state == ADC_ALARM_HIGH && mv + chan->hyst_mv < chan->high_mv) ||
+             (state == ADC_ALARM_LOW && mv > chan->low_mv + chan->hyst_mv))
+        state = ADC_ALARM_NORMAL;
+    if (state == chan->state)
+        return;                     // 没有越过门限，不唤醒任何人
+
+    ev.timestamp_ns = adc_stream_ts;
+    ev.channel = channel;
+    ev.state = state;
+    ev.prev = chan->state;
+    ev.mv = mv;
+    chan->state = state;
+    trace_adc12m_alarm(DEVICE_NAME, channel, mv);
+    if (kfifo_in(&adc_alarm_fifo, &ev, 1) == 0) {
+        drv_stats_inc(&adc_stats, ADC_STAT_ALARM_DROPPED);
+        return;
+    }
+    drv_stats_inc(&adc_stats, ADC_STAT_ALARMS);
+    wake_up_interruptible(&adc_waitq);
+}
+
+/**
+ * @brief 转换结束中断，与内核自带的 ADC 驱动共用中断号，不是本驱动启动的转换不处理
+ *        连续采样时把采样放入队列，报警监视时检查门限
+ */
+static irqreturn_t adc_irq_handler(int irq, void *dev_id)
+{
+    struct adc_sample sample;
+    unsigned int raw;
+    unsigned int value;
+
+    if (!ACCESS_ONCE(adc_busy))
+        return IRQ_NONE;
+    adc_busy = 0;
+    iowrite32(1, adcintclr_va);     // 清除中断挂起位
+
+    if (!adc_streaming && !adc_alarming) {
+        complete(&adc_done);
+        return IRQ_HANDLED;
+    }
+
+    raw = ioread32(adcdat_va) & 0xFFF;
+    if (adc_alarming) {
+        adc_alarm_sample(adc_stream_channel, raw);
+        return IRQ_HANDLED;
+    }
+    if (!adc_filter_push(&adc_stream_filter, raw, &value))
+        return IRQ_HANDLED;         // 抽取，这个转换不产生采样
+
+    sample.timestamp_ns = adc_stream_ts;
+    sample.channel = adc_stream_channel;
+    sample.raw = raw;
+    sample.value = value;
+    if (adc_ring_put(&sample) != 0) {
+        drv_stats_inc(&adc_stats, ADC_STAT_DROPPED);
+        return IRQ_HANDLED;
+    }
+    drv_stats_inc(&adc_stats, ADC_STAT_SAMPLES);
+    if (adc_ring->head - ACCESS_ONCE(adc_ring->tail) >= adc_stream_watermark)
+        wake_up_interruptible(&adc_waitq);
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief 连续采样/报警监视的节拍，中断上下文，只启动转换，结果由 adc_irq_handler 取走
+ */
+static enum hrtimer_restart adc_stream_timer_fn(struct hrtimer *timer)
+{
+    u64 missed = hrtimer_forward_now(timer, adc_stream_period);
+
+    if (missed > 1)
+        drv_stats_add(&adc_stats, ADC_STAT_OVERRUNS, (int)(missed - 1));
+
+    if (ACCESS_ONCE(adc_busy)) {
+        drv_stats_inc(&adc_stats, ADC_STAT_OVERRUNS);
+        if (++adc_stream_stall <= adc_stream_stall_max)
+            return HRTIMER_RESTART;
+        // 等了 ADC_CONVERT_TIMEOUT_MS 中断还没有来，放弃这次转换，否则之后的节拍全部空转
+        drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+        iowrite32(1, adcintclr_va);
+    }
+    adc_stream_stall = 0;
+    adc_stream_ts = ktime_to_ns(ktime_get());
+    adc_busy = 1;
+    if (!adc_alarming) {
+        iowrite32(ioread32(adcon_va) | (1 << 0), adcon_va);     // 通道在开始采样时已选好
+        return HRTIMER_RESTART;
+    }
+
+    // 报警监视：轮到 mask 中的下一个通道，选择通道的同时启动转换
+    do {
+        adc_stream_channel = (adc_stream_channel + 1) & (ADC_CHANNELS - 1);
+    } while (!(adc_alarm_mask & (1 << adc_stream_channel)));
+    iowrite32((ioread32(adcon_va) & ~(7 << 3)) | (adc_stream_channel << 3) | (1 << 0), adcon_va);
+    return HRTIMER_RESTART;
+}
+
+/**
+ * @brief 第一次打开时上电，设备打开期间保持，每次转换不再重新配置
+ */
+static void adc_hw_on(void)
+{
+    // [9:0] = 199，预分频值 199+1，[15] = 1 启用预分频
+    iowrite32((ioread32(prescalercon_va) & ~0x3FF) | ADC_PRESCALER, prescalercon_va);
+    iowrite32(ioread32(prescalercon_va) | (1 << 15), prescalercon_va);
+
+    // [2] = 0，开启电源
+    iowrite32(ioread32(adcon_va) & ~(1 << 2), adcon_va);
+
+    // 清除挂起位，使能转换结束中断
+    iowrite32(1, adcintclr_va);
+    iowrite32(1, adcintenb_va);
+}
+
+/**
+ * @brief 最后一次关闭时断电
+ */
+static void adc_hw_off(void)
+{
+    iowrite32(0, adcintenb_va);
+    // [15] = 0 关闭预分频(CLKIN)，[2] = 1 关闭电源
+    iowrite32(ioread32(prescalercon_va) & ~(1 << 15), prescalercon_va);
+    iowrite32(ioread32(adcon_va) | (1 << 2), adcon_va);
+}
+
+/**
+ * @brief 转换一次，等待中断期间睡眠，调用者须已打开设备并持有 adc_mutex
+ * @param channel 通道 0~3
+ * @param raw     12 位原始值
+ * @return 成功返回 0，超时返回 -ETIMEDOUT
+ */
+static int adc_convert_locked(unsigned int channel, unsigned int *raw)
+{
+    INIT_COMPLETION(adc_done);
+    adc_busy = 1;
+
+    // [5:3] 选择通道，[0] = 1 启动转换，转换结束时硬件清零并产生中断
+    iowrite32((ioread32(adcon_va) & ~(7 << 3)) | (channel << 3), adcon_va);
+    iowrite32(ioread32(adcon_va) | (1 << 0), adcon_va);
+
+    if (wait_for_completion_timeout(&adc_done, msecs_to_jiffies(ADC_CONVERT_TIMEOUT_MS)) == 0) {
+        adc_busy = 0;
+        return -ETIMEDOUT;
+    }
+    *raw = ioread32(adcdat_va) & 0xFFF;     // 低12位有效
+    return 0;
+}
+
+/**
+ * @brief 按当前滤波参数转换 adc_filter_burst() 次，取最后一个输出，
+ *        每次从清空的状态开始，结果不受之前的转换影响；调用者持有 adc_mutex
+ * @param value 16 位定标值
+ * @return 成功返回 0，转换超时返回 -ETIMEDOUT，没有得到输出返回 -EIO
+ */
+static int adc_convert_filtered_locked(unsigned int channel, unsigned int *value)
+{
+    struct adc_filter filter;
+    unsigned int n = adc_filter_burst(&adc_filter_conf);
+    unsigned int raw;
+    unsigned int i;
+    int have = 0;
+    int ret = 0;
+
+    adc_filter_reset(&filter, &adc_filter_conf);
+    for (i = 0; i < n && ret == 0; i++) {
+        ret = adc_convert_locked(channel, &raw);
+        if (ret == 0 && adc_filter_push(&filter, raw, value))
+            have = 1;               // adc_filter_check() 保证第 n 个输入有输出
+    }
+    drv_stats_add(&adc_stats, ADC_STAT_CONVERSIONS, ret == 0 ? n : i - 1);
+    if (ret == 0 && !have)
+        ret = -EIO;                 // 不把调用者未初始化的 value 当作结果
+    return ret;
+}
+
+/**单次(滤波)转换，连续采样中返回 -EBUSY */
+static int adc_convert(unsigned int channel, unsigned int *value)
+{
+    int ret;
+
+    mutex_lock(&adc_mutex);
+    if (adc_streaming || adc_alarming) {
+        mutex_unlock(&adc_mutex);
+        return -EBUSY;              // 连续采样期间 ADC 被节拍占用
+    }
+    ret = adc_convert_filtered_locked(channel, value);
+    mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+/**
+ * @brief 依次转换 mask 中的通道，期间一直持有 adc_mutex，不被其他转换插入
+ * @return 成功返回 0，mask 为空或含有不存在的通道返回 -EINVAL，
+ *         连续采样或报警监视中返回 -EBUSY
+ */
+static int adc_scan(struct adc_scan *scan)
+{
+    unsigned int value = 0;
+    unsigned int ch;
+    int ret = 0;
+
+    scan->count = 0;
+    if (scan->mask == 0 || (scan->mask >> ADC_CHANNELS) != 0)
+        return -EINVAL;
+
+    mutex_lock(&adc_mutex);
+    if (adc_streaming || adc_alarming) {
+        mutex_unlock(&adc_mutex);
+        return -EBUSY;              // 连续采样期间 ADC 被节拍占用
+    }
+    for (ch = 0; ch < ADC_CHANNELS && ret == 0; ch++) {
+        if (!(scan->mask & (1 << ch)))
+            continue;
+        ret = adc_convert_filtered_locked(ch, &value);
+        if (ret == 0) {
+            scan->raw[scan->count] = (value + (1 << ADC_FILTER_FRAC_BITS >> 1)) >> ADC_FILTER_FRAC_BITS;
+            scan->mv[scan->count] = adc_filter_to_mv(value);
+            scan->value[scan->count] = value;
+            scan->count++;
+        }
+    }
+    mutex_unlock(&adc_mutex);
+    return ret;
+}
+
+/**
+ * @brief 开始连续采样，清空队列；rate_hz 是转换的速率，滤波时放入队列的速率
+ *        为 rate_hz / decimation，watermark 按放入队列的采样计
+ * @return 参数错误返回 -EINVAL，已在采样或报警监视返回 -EBUSY
+ */
+static int adc_stream_start(const struct adc_stream_cfg *cfg)
+{
+    if (cfg->channel > 3 || cfg->rate_hz == 0 || cfg->rate_hz > ADC_STREAM_MAX_HZ)
+        return -EINVAL;
+
+    mutex_lock(&adc_mutex);
+    if (adc_streaming || adc_alarming) {
+        mutex_unlock(&adc_mutex);
+        return -EBUSY;
+    }
+
+    mutex_lock(&adc_read_lock);
+    adc_ring->head = 0;
+    adc_ring->tail = 0;
+    adc_ring->dropped = 0;
+    kfifo_reset(&adc_alarm_fifo);           // 上次监视剩下的事件不再读出，read 改为取采样
+    mutex_unlock(&adc_read_lock);
+
+    adc_stream_channel = cfg->channel;
+    adc_stream_watermark = clamp_t(unsigned int, cfg->watermark, 1, ADC_RING_SIZE / 2);
+    adc_stream_period = ktime_set(0, NSEC_PER_SEC / cfg->rate_hz);
+    adc_stream_stall = 0;
+    adc_stream_stall_max = cfg->rate_hz * ADC_CONVERT_TIMEOUT_MS / 1000 + 1;
+    adc_filter_reset(&adc_stream_filter, &adc_filter_conf);
+
+    // [5:3] 选择通道，整个采样期间不变
+    iowrite32((ioread32(adcon_va) & ~(7 << 3)) | (cfg->channel << 3), adcon_va);
+
+    adc_streaming = 1;
+    hrtimer_start(&adc_stream_timer, adc_stream_period, HRTIMER_MODE_REL);
+    mutex_unlock(&adc_mutex);
+
+    pr_debug("adc stream start: channel %u, %u Hz\n", cfg->channel, cfg->rate_hz);
+    return 0;
+}
+
+/**
+ * @brief 开始报警监视，清空事件队列
+ * @return 参数错误返回 -EINVAL，已在采样或报警监视返回 -EBUSY
+ */
+static int adc_alarm_start(const struct adc_alarm_cfg *cfg)
+{
+    struct adc_alarm_chan *chan;
+    unsigned int ch;
+
+    if (cfg->mask == 0 || (cfg->mask >> ADC_CHANNELS) != 0 ||
+        cfg->rate_hz == 0 || cfg->rate_hz > ADC_STREAM_MAX_HZ)
+        return -EINVAL;
+    for (ch = 0; ch < ADC_CHANNELS; ch++) {
+        if (!(cfg->mask & (1 << ch)))
+            continue;
+        if (cfg->high_mv[ch] == 0 && cfg->low_mv[ch] == 0)
+            return -EINVAL;         // 两侧都不检查，永远不会报警
+        if (cfg->high_mv[ch] && cfg->hyst_mv[ch] >= cfg->high_mv[ch])
+            return -EINVAL;
+        if (cfg->high_mv[ch] && cfg->low_mv[ch] &&
+            cfg->low_mv[ch] + cfg->hyst_mv[ch] >= cfg->high_mv[ch] - cfg->hyst_mv[ch])
+            return -EINVAL;         // 两个回差区间重叠
+    }
+
+    mutex_lock(&adc_mutex);
+    if (adc_streaming || adc_alarming) {
+        mutex_unlock(&adc_mutex);
+        return -EBUSY;
+    }
+
+    mutex_lock(&adc_read_lock);
+    kfifo_reset(&adc_alarm_fifo);
+    mutex_unlock(&adc_read_lock);
+
+    for (ch = 0; ch < ADC_CHANNELS; ch++) {
+        chan = &adc_alarm_chans[ch];
+        adc_filter_reset(&chan->filter, &adc_filter_conf);
+        chan->high_mv = cfg->high_mv[ch];
+        chan->low_mv = cfg->low_mv[ch];
+        chan->hyst_mv = cfg->hyst_mv[ch];
+        chan->state = ADC_ALARM_UNKNOWN;
+    }
+    adc_alarm_mask = cfg->mask;
+    adc_stream_channel = ADC_CHANNELS - 1;      // 第一个节拍从通道 0 开始找
+    adc_stream_period = ktime_set(0, NSEC_PER_SEC / cfg->rate_hz);
+    adc_stream_stall = 0;
+    adc_stream_stall_max = cfg->rate_hz * ADC_CONVERT_TIMEOUT_MS / 1000 + 1;
+
+    adc_alarming = 1;
+    hrtimer_start(&adc_stream_timer, adc_stream_period, HRTIMER_MODE_REL);
+    mutex_unlock(&adc_mutex);
+
+    pr_debug("adc alarm start: mask 0x%x, %u Hz\n", cfg->mask, cfg->rate_hz);
+    return 0;
+}
+
+/**
+ * @brief 停止连续采样或报警监视，调用者持有 adc_mutex
+ */
+static void adc_stream_stop(void)
+{
+    int i;
+
+    if (!adc_streaming && !adc_alarming)
+        return;
+
+    hrtimer_cancel(&adc_stream_timer);
+    // 等最后一次转换的中断把采样放入队列，之后 adc_busy 留给单次转换使用
+    for (i = 0; ACCESS_ONCE(adc_busy) && i < 100; i++)
+        udelay(10);
+    adc_busy = 0;
+    adc_streaming = 0;
+    adc_alarming = 0;
+
+    wake_up_interruptible(&adc_waitq);      // 读者取走剩余的采样，或返回 0
+}
+
 static int adc_open(struct inode *inode, struct file *pFile)
 {
-    printk(KERN_INFO "adc_open success\n");
-    return 0;   
+    mutex_lock(&adc_mutex);
+    if (adc_users++ == 0)
+        adc_hw_on();
+    mutex_unlock(&adc_mutex);
+
+    pr_debug("adc_open success\n");
+    return 0;
 }
 
 static int adc_close(struct inode *inode, struct file *pFile)
 {
-    printk(KERN_INFO "adc device close\n");
+    mutex_lock(&adc_mutex);
+    if (--adc_users == 0) {
+        adc_stream_stop();
+        adc_hw_off();
+    }
+    mutex_unlock(&adc_mutex);
+
+    pr_debug("adc device close\n");
     return 0;
 }
 
+/**
+ * @brief 有报警事件，或在报警监视中
+ */
+static int adc_alarm_mode(void)
+{
+    return ACCESS_ONCE(adc_alarming) || !kfifo_is_empty(&adc_alarm_fifo);
+}
+
+/**
+ * @brief 取出报警事件
+ * @return 读到的字节数；没有事件时阻塞，O_NONBLOCK 时返回 -EAGAIN；
+ *         已停止监视且队列为空时返回 0
+ */
+static ssize_t adc_alarm_read(struct file *pFile, char __user *buf, size_t count)
+{
+    unsigned int copied;
+    int ret;
+
+    if (count < sizeof(struct adc_alarm_event))
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&adc_read_lock))
+        return -ERESTARTSYS;
+
+    while (kfifo_is_empty(&adc_alarm_fifo)) {
+        mutex_unlock(&adc_read_lock);
+        if (!ACCESS_ONCE(adc_alarming))
+            return 0;
+        if (pFile->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(adc_waitq, !kfifo_is_empty(&adc_alarm_fifo) || !ACCESS_ONCE(adc_alarming)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&adc_read_lock))
+            return -ERESTARTSYS;
+    }
+
+    ret = kfifo_to_user(&adc_alarm_fifo, buf, count, &copied);
+    mutex_unlock(&adc_read_lock);
+    if (ret != 0) {
+        drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+        return ret;
+    }
+    return copied;
+}
+
+/**
+ * @brief 取出连续采样的采样点；报警监视时取出报警事件
+ * @param count 至少为 sizeof(struct adc_sample)，一次最多取出 count / sizeof(struct adc_sample) 个
+ * @return 读到的字节数；不足 watermark 个时阻塞，O_NONBLOCK 时返回 -EAGAIN；
+ *         没有在连续采样且队列为空时返回 0
+ */
 static ssize_t adc_read(struct file *pFile, char __user *buf, size_t count, loff_t *ppos)
 {
-    /*
-        unsigned long value = 0x55; // TODO: 替换为实际ADC读取
-        if (copy_to_user(buf, &value, sizeof(value)))
-            return -EFAULT;
+    unsigned int head;
+    unsigned int tail;
+    unsigned int n;
+    unsigned int first;
+
+    if (adc_alarm_mode())
+        return adc_alarm_read(pFile, buf, count);
+
+    if (count < sizeof(struct adc_sample))
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&adc_read_lock))
+        return -ERESTARTSYS;
+
+    while (!adc_stream_ready()) {
+        mutex_unlock(&adc_read_lock);
+        if (!ACCESS_ONCE(adc_streaming))
+            return 0;
+        if (pFile->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(adc_waitq, adc_stream_ready() || !ACCESS_ONCE(adc_streaming)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&adc_read_lock))
+            return -ERESTARTSYS;
+    }
 
-        return sizeof(value);
-    */
-    printk(KERN_INFO "adc adc_read success\n");
-    return 0;
+    head = ACCESS_ONCE(adc_ring->head);
+    tail = adc_ring->tail;
+    smp_rmb();                      // 先读 head，再读采样
+    if (head - tail > ADC_RING_SIZE)
+        tail = head - ADC_RING_SIZE;    // 映射方写坏了 tail，丢弃最旧的
+
+    n = min_t(unsigned int, head - tail, count / sizeof(struct adc_sample));
+    first = min_t(unsigned int, n, ADC_RING_SIZE - (tail & (ADC_RING_SIZE - 1)));
+    if (copy_to_user(buf, &adc_ring_data[tail & (ADC_RING_SIZE - 1)], first * sizeof(struct adc_sample)) ||
+        copy_to_user(buf + first * sizeof(struct adc_sample), adc_ring_data, (n - first) * sizeof(struct adc_sample))) {
+        mutex_unlock(&adc_read_lock);
+        drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+        return -EFAULT;
+    }
+    smp_mb();                       // 采样读完，再释放空间
+    adc_ring->tail = tail + n;
+    mutex_unlock(&adc_read_lock);
+
+    trace_adc12m_stream_read(DEVICE_NAME, adc_stream_channel, n);
+    return n * sizeof(struct adc_sample);
+}
+
+/**
+ * @brief 把采样队列映射到用户空间，偏移须为 0，长度不超过控制页 + 采样数组
+ */
+static int adc_mmap(struct file *pFile, struct vm_area_struct *vma)
+{
+    if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_ALIGN(ADC_RING_BYTES))
+        return -EINVAL;
+    return remap_vmalloc_range(vma, adc_ring_mem, 0);
+}
+
+/**
+ * @brief 与 read 取同一个队列：报警监视时有报警事件可读，
+ *        否则采样队列达到 watermark 时可读(上次采样剩下的采样不唤醒报警监视者)
+ */
+static unsigned int adc_poll(struct file *pFile, struct poll_table_struct *wait)
+{
+    int ready;
+
+    poll_wait(pFile, &adc_waitq, wait);
+    if (adc_alarm_mode())
+        ready = !kfifo_is_empty(&adc_alarm_fifo);
+    else
+        ready = adc_stream_ready();
+    return ready ? (POLLIN | POLLRDNORM) : 0;
 }
 
 static long adc_ioctl(struct file *pFile, unsigned int cmd, unsigned long arg)
 {
-    unsigned long adc_value = 0;
+    struct adc_scan scan;
+    struct adc_stream_cfg cfg;
+    struct adc_filter_cfg fcfg;
+    struct adc_alarm_cfg acfg;
+    unsigned int adc_value = 0;
     unsigned long adc_vol = 0;
-    unsigned int reg_val;
+    unsigned int channel;
     int ret = -1;
 
-    printk(KERN_INFO "adc ioctl: cmd = %d\n", cmd);
+    pr_debug("adc_ioctl: cmd = 0x%x\n", cmd);
 
     switch (cmd) {
+        case ADC_IOCTL_STREAM_START:
+            if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg)))
+                return -EFAULT;
+            return adc_stream_start(&cfg);
+        case ADC_IOCTL_STREAM_STOP:
+        case ADC_IOCTL_ALARM_STOP:
+            mutex_lock(&adc_mutex);
+            adc_stream_stop();
+            mutex_unlock(&adc_mutex);
+            return 0;
+        case ADC_IOCTL_ALARM_START:
+            if (copy_from_user(&acfg, (void __user *)arg, sizeof(acfg)))
+                return -EFAULT;
+            return adc_alarm_start(&acfg);
+        case ADC_IOCTL_SET_FILTER:
+            if (copy_from_user(&fcfg, (void __user *)arg, sizeof(fcfg)))
+                return -EFAULT;
+            ret = adc_filter_check(&fcfg);
+            if (ret != 0)
+                return ret;
+            mutex_lock(&adc_mutex);
+            if (adc_streaming || adc_alarming) {
+                mutex_unlock(&adc_mutex);
+                return -EBUSY;      // 中断正在使用滤波状态
+            }
+            adc_filter_conf = fcfg;
+            mutex_unlock(&adc_mutex);
+            return 0;
+        case ADC_IOCTL_GET_FILTER:
+            mutex_lock(&adc_mutex);
+            fcfg = adc_filter_conf;
+            mutex_unlock(&adc_mutex);
+            if (copy_to_user((void __user *)arg, &fcfg, sizeof(fcfg)))
+                return -EFAULT;
+            return 0;
+        case ADC_IOCTL_SCAN:
+            if (copy_from_user(&scan, (void __user *)arg, sizeof(scan)))
+                return -EFAULT;
+            ret = adc_scan(&scan);
+            if (ret != 0) {
+                drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+                return ret;
+            }
+            if (copy_to_user((void __user *)arg, &scan, sizeof(scan))) {
+                drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+                return -EFAULT;
+            }
+            return 0;
         case GEC6818_ADC_IN0:   // [5:3]=000 通道0
-            reg_val = ioread32(adcon_va);
-            reg_val &= (~(7 << 3));
-            iowrite32(reg_val, adcon_va);
-            break;
         case GEC6818_ADC_IN1:   // [5:3]=001 通道1
-            iowrite32((ioread32(adcon_va) & ((~(7 << 3)))), adcon_va);
-            iowrite32((ioread32(adcon_va) | ((1 << 3))), adcon_va);
-            break;
         case GEC6818_ADC_IN2:   // [5:3]=010 通道2
-            iowrite32((ioread32(adcon_va) & ((~(7 << 3)))), adcon_va);
-            iowrite32((ioread32(adcon_va) | ((2 << 3))), adcon_va);
-            break;
         case GEC6818_ADC_IN3:   // [5:3]=011 通道3
-            iowrite32((ioread32(adcon_va) & ((~(7 << 3)))), adcon_va);
-            iowrite32((ioread32(adcon_va) | ((3 << 3))), adcon_va);
+            channel = _IOC_NR(cmd);
             break;
         default:
-            printk(KERN_ERR "adc_ioctl failed\n");
+            drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+            pr_debug("adc_ioctl: unknown cmd 0x%x\n", cmd);
             return -ENOIOCTLCMD;
     }
 
-    // 将ADC的电源开启 [2] = 0，开启电源
-    iowrite32(ioread32(adcon_va) & ~(1 << 2), adcon_va);
-
-    // [9:0] = 199 + 1 = 200，预分频值设置为 199+1，ADC 工作频率 = 200MHz / (199+1) = 1MHz
-    iowrite32(ioread32(prescalercon_va) & ~(0x3FF << 0), prescalercon_va);  // 清除低10位
-    iowrite32(ioread32(prescalercon_va) | (199 << 0), prescalercon_va);     // 设置为199
-
-    // 预分频值使能 [15] = 1，启用预分频
-    iowrite32(ioread32(prescalercon_va) | (1 << 15), prescalercon_va);
-
-    // ADC 使能 [0] = 1，启动 ADC 转换
-    iowrite32(ioread32(adcon_va) | (1 << 0), adcon_va);
-
-    // 等待 AD 转换结束 [0] = 0，表示转换完成
-    while (ioread32(adcon_va) & (1 << 0));
-
-    // 读取12bit数据（低12位有效）
-    adc_value = ioread32(adcdat_va) & 0xFFF;
-
-    // 关闭CLKIN时钟输入 [15]=0, disable
-    iowrite32(ioread32(prescalercon_va) & ~(1 << 15), prescalercon_va);
-
-    // 关闭ADC电源 [2]=1, power off
-    iowrite32(ioread32(adcon_va) | (1 << 2), adcon_va);
+    // ADC 在 open 时已上电，这里只选择通道、启动转换并等待中断
+    ret = adc_convert(channel, &adc_value);
+    if (ret != 0) {
+        drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
+        return ret;
+    }
 
     // 将AD转换的结果值换算为电压值（假设参考电压为1.8V）
-    // 12位ADC最大值：4095，ADC的参考电压为：1.8V
-    adc_vol = adc_value * 1800 / 4095; // 单位：mV
+    // 12位ADC最大值：4095(定标值 65520)，ADC的参考电压为：1.8V
+    adc_vol = adc_filter_to_mv(adc_value); // 单位：mV
+    trace_adc12m_convert(DEVICE_NAME, _IOC_NR(cmd), (int)adc_vol);
 
     // 将电压值复制到用户空间
     ret = copy_to_user((void *)arg, &adc_vol, 4);
 
-    if (ret != 0)
+    if (ret != 0) {
+        drv_stats_inc(&adc_stats, ADC_STAT_ERRORS);
         return -EFAULT;
+    }
 
     return 0;
 }
@@ -212,4 +979,28 @@ MODULE_VERSION("2025-10-02_V1.0.1");
  * 改动历史纪录：
  * Revision 1.0, 2025-10-02, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: ioctl/read 路径上的 printk 改为 adc12m_convert 跟踪点与 pr_debug，
+ *           增加 debugfs 计数器 /sys/kernel/debug/adc12_misc/stats.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 转换结束由中断通知，进程睡眠等待，不再忙等 ADCCON[0]；
+ *           电源和预分频在设备打开期间保持，不再每次转换重新配置；
+ *           出错路径注销杂项设备，不再释放未申请的内存区域.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 增加连续采样：ADC_IOCTL_STREAM_START/STOP，hrtimer 节拍启动转换，
+ *           {时间戳, 通道, 原始值} 放入 kfifo，read 批量取出，支持 poll.
+ * Revision 1.4, 2026-10-17, lium
+ * describe: 采样队列改为 vmalloc_user 环形队列，支持 mmap：控制页中的 head/tail
+ *           由内核和消费者各自更新，消费者不复制、不进行系统调用地读取采样.
+ * Revision 1.5, 2026-10-17, lium
+ * describe: 增加 ADC_IOCTL_SCAN，一次调用依次转换多个通道.
+ * Revision 1.6, 2026-10-17, lium
+ * describe: 增加过采样滤波 ADC_IOCTL_SET_FILTER/GET_FILTER(adc_filter.h)：
+ *           滑动平均、中值和 CIC 抽取，整数定点运算；采样点增加 16 位定标的滤波结果.
+ * Revision 1.7, 2026-10-17, lium
+ * describe: 增加报警监视 ADC_IOCTL_ALARM_START/STOP：后台轮流转换多个通道，
+ *           越过带回差的上/下限时才把事件放入 kfifo 并唤醒 read/poll.
+ * Revision 1.8, 2026-10-17, lium
+ * describe: 连续采样/报警监视的转换结束中断丢失时，约 ADC_CONVERT_TIMEOUT_MS 后
+ *           记一次错误并重新启动转换，不再一直空转到停止.
  *************************************************************************/
@@ -8,6 +8,8 @@
  *   生成日期: 2025-10-05
  *   作    者: lium
  *   功    能: platform总线设备
+ *             按键设备和标准输入放在同一个 epoll 中，按键事件到来时批量读出并打印，
+ *             标准输入输入 q 退出.
  *
  ************************************************************************/
 #include <stdio.h>
@@ -18,64 +20,92 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
 
 
 #define DEV_NAME		"/dev/gecBt"                // 设备名字 /dev/DEV_NAME
 #define BTN_SIZE            4                       /**按键的数量 */
+#define BTN_BATCH           16                      // 一次 read 最多取出的事件数
 
+/**按键事件，与驱动中的定义一致 */
+struct btn_event {
+    unsigned long long timestamp_ns;
+    unsigned int key;
+    unsigned int pressed;
+};
+
+/**
+ * @brief 取出并打印按键设备中的所有事件
+ * @return 成功返回 0
+ */
+static int btn_drain(int button_fd)
+{
+    struct btn_event ev[BTN_BATCH];
+    ssize_t ret;
+    int i;
+
+    // 设备以 O_NONBLOCK 打开，取空后返回 -EAGAIN
+    while ((ret = read(button_fd, ev, sizeof(ev))) > 0) {
+        for (i = 0; i < (int)(ret / sizeof(ev[0])); i++) {
+            printf("[%llu.%06llu] K%u \t%s\n",
+                   ev[i].timestamp_ns / 1000000000ULL, ev[i].timestamp_ns / 1000ULL % 1000000,
+                   ev[i].key + 1, ev[i].pressed ? "Pressed, down" : "Release, up");
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct epoll_event events[2];
+    struct epoll_event ev;
+    int button_fd;
+    int epfd;
+    int n;
+    int i;
+    char cmd[64];
 
-int main(int argc, char **argv){
-    int button_fd, ret;
-    char prior_button_value[BTN_SIZE] = {'0', '0', '0', '0'};          // 按键的最初状态
-    char current_button_value[BTN_SIZE] = {'0', '0', '0', '0'};        // 保存当前按键的状态
-    
     /**1. 打开设备文件 */
-    button_fd = open(DEV_NAME, O_RDWR);  // 打开设备
+    button_fd = open(DEV_NAME, O_RDWR | O_NONBLOCK);  // 打开设备
     if (button_fd < 0) {
         perror("open device");
         exit(1);
     }
-    
-    // 主循环：持续读取按钮状态
-    while (1) {
-        int i;
 
-        // 从设备读取当前按钮值
-        ret = read(button_fd, current_button_value, BTN_SIZE);
-        if (ret != BTN_SIZE) {
-            perror("read buttons");
-            exit(1);
-        }
-
-        // 遍历每个按钮位，判断是否发生变化
-        for (i = 0; i < BTN_SIZE; i++) {
-            // 如果当前值与上一次不同，说明按键有动作
-            if (prior_button_value[i] != current_button_value[i]) {
-                prior_button_value[i] = current_button_value[i];  // 更新旧值
-
-                printf("\n************************************\n");
+    /**2. 按键设备和标准输入都放入 epoll */
+    epfd = epoll_create(2);
+    if (epfd < 0) {
+        perror("epoll_create");
+        exit(1);
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = button_fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, button_fd, &ev) != 0) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = STDIN_FILENO;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, STDIN_FILENO, &ev);
 
-                switch (i) {
-                    case 0:
-                        printf("K1 \t%s\n", current_button_value[i] == '0' ? "Release, up" : "Pressed, down");
-                        break;
-                    case 1:
-                        printf("K2 \t%s\n", current_button_value[i] == '0' ? "Release, up" : "Pressed, down");
-                        break;
-                    case 2:
-                        printf("K3 \t%s\n", current_button_value[i] == '0' ? "Release, up" : "Pressed, down");
-                        break;
-                    case 3:
-                        printf("K4 \t%s\n", current_button_value[i] == '0' ? "Release, up" : "Pressed, down");
-                        break;
-                    default:
-                        break;
-                }
+    // 主循环：睡眠直到有按键事件或输入
+    while (1) {
+        n = epoll_wait(epfd, events, 2, -1);
+        if (n < 0) {
+            perror("epoll_wait");
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (events[i].data.fd == button_fd) {
+                btn_drain(button_fd);
+            } else if (fgets(cmd, sizeof(cmd), stdin) == NULL || cmd[0] == 'q') {
+                goto out;
             }
         }
     }
 
-    // 理论上不会执行到这里，但为了防止警告可以加上
+out:
+    close(epfd);
     close(button_fd);
     return 0;
 }
@@ -85,4 +115,7 @@ int main(int argc, char **argv){
  * 改动历史纪录：
  * Revision 1.0, 2025-10-05, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 驱动改为事件队列，read 一次取出多个 {按键, 按下/松开, 时间戳}，
+ *           主循环改为 epoll，同时等待按键和标准输入.
  *************************************************************************/
\ No newline at end of file
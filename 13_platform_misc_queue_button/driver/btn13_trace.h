@@ -0,0 +1,73 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: btn13_trace.h
+ *   软件模块: 跟踪点
+ *   功    能: 按键驱动的 tracepoint，字段统一为 dev/pin/value/ts，
+ *             ts 为 CLOCK_MONOTONIC 纳秒，可直接与应用层的时间对齐。
+ *             默认关闭，几乎没有开销；需要时：
+ *             echo 1 > /sys/kernel/debug/tracing/events/btn13/enable
+ *             cat /sys/kernel/debug/tracing/trace_pipe
+ *             或 perf record -e 'btn13:*'
+ *
+ ************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM btn13
+
+#if !defined(BTN13_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define BTN13_TRACE_H_
+
+#include <linux/tracepoint.h>
+#include <linux/ktime.h>
+
+/**
+ * dev   设备名
+ * pin   中断号(irq/debounce 事件)，读事件为 -1
+ * value irq 事件为中断时的引脚电平，debounce 事件为消抖后的按键状态(1 按下)，
+ *       读事件为读到的字节数
+ */
+DECLARE_EVENT_CLASS(btn13_pin_class,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value),
+    TP_STRUCT__entry(
+        __string(dev, dev)
+        __field(int, pin)
+        __field(int, value)
+        __field(u64, ts)
+    ),
+    TP_fast_assign(
+        __assign_str(dev, dev);
+        __entry->pin = pin;
+        __entry->value = value;
+        __entry->ts = ktime_to_ns(ktime_get());
+    ),
+    TP_printk("dev=%s pin=%d value=%d ts=%llu",
+              __get_str(dev), __entry->pin, __entry->value,
+              (unsigned long long)__entry->ts)
+);
+
+/**每次按键中断一个事件 */
+DEFINE_EVENT(btn13_pin_class, btn13_irq,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+/**消抖后按键状态变化一个事件，与 read 读到的事件一一对应 */
+DEFINE_EVENT(btn13_pin_class, btn13_debounce,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+/**每次 read 返回一个事件 */
+DEFINE_EVENT(btn13_pin_class, btn13_read,
+    TP_PROTO(const char *dev, int pin, int value),
+    TP_ARGS(dev, pin, value)
+);
+
+#endif  /* BTN13_TRACE_H_ */
+
+/* 跟踪头文件在驱动目录下，Makefile 中需要 CFLAGS_xxx.o := -I$(src) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE btn13_trace
+#include <trace/define_trace.h>
@@ -8,6 +8,10 @@
  *   生成日期: 2025-10-05
  *   作    者: lium
  *   功    能: platform总线驱动
+ *             按键的双边沿中断只重新启动该按键的消抖定时器，抖动期间的边沿都推迟它；
+ *             定时器到期(debounce_ms 内没有新边沿)时读取引脚电平，与上次报告的状态
+ *             不同才把 {按键, 按下/松开, 时间戳} 放入 kfifo 并唤醒读者，
+ *             read 一次取出多个事件，队列非空时 poll 返回 POLLIN.
  *
  ************************************************************************/
 #include <linux/module.h>
@@ -17,21 +21,43 @@
 #include <asm/uaccess.h>
 #include <linux/platform_device.h>
 #include <linux/miscdevice.h>
+#include <linux/kfifo.h>            // 按键事件队列
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+#include <linux/timer.h>            // 消抖定时器
+#include <linux/gpio.h>             // gpio_get_value
+#include <mach/platform.h>          // IRQ_GPIO_START
+#include "drv_stats.h"
+#define CREATE_TRACE_POINTS
+#include "btn13_trace.h"
 
 #define DEV_NAME		"gecBt"                // 设备名字 /dev/DEV_NAME
 #define DRIVICE_NAME    "buttons_driver"       // 用于device和drivice的匹配名称
 
 /**等待队列 */
-static wait_queue_head_t button_waitq;
+static DECLARE_WAIT_QUEUE_HEAD(button_waitq);
 
 /**按键的数量 */
 #define BTN_SIZE            4
 
+/**消抖时间，可在 /sys/module/<模块名>/parameters/debounce_ms 中修改，对下一个边沿生效 */
+#define BTN_DEBOUNCE_MAX_MS 200
+static unsigned int debounce_ms = 20;
+module_param(debounce_ms, uint, 0644);
+MODULE_PARM_DESC(debounce_ms, "button debounce interval in ms (0 ~ 200)");
+
 /**按键信息 */
 typedef struct button_desc {
 	int irq;                                        // 中断号
 	int number;                                     // 按键序号 第几个按键
 	const char *name;	                            // 按键的名字
+	int gpio;                                       // 中断号对应的引脚，低电平为按下
+	struct timer_list timer;                        // 消抖定时器，每个边沿重新计时
+	int bouncing;                                   // 定时器等待中，edge_ns 已记录
+	unsigned long long edge_ns;                     // 这一串抖动的第一个边沿的时刻
 }TButtonDesc_t;
 
 static TButtonDesc_t buttons[BTN_SIZE];            //定义按键结构体数组
@@ -39,16 +65,39 @@ static TButtonDesc_t buttons[BTN_SIZE];            //定义按键结构体数组
 /**平台总线获取到的硬件资源 */
 static struct resource *pBtnResource;
 
-/**按键的状态。*/
-static volatile int keyValues[BTN_SIZE] = {0, 0, 0, 0};
+/**按键最近一次报告的状态，1 按下，打开设备时按引脚初始化，之后只在消抖定时器中修改。*/
+static int keyValues[BTN_SIZE] = {0, 0, 0, 0};
 
-/**是否阻塞等待标准位。0：阻塞等待；1：不阻塞等待 */
-static volatile int ev_press = 0;
+/**
+ * 按键事件，read 每次返回整数个，count 小于一个时返回 -EINVAL。
+ */
+struct btn_event {
+    unsigned long long timestamp_ns;    // 引起这次变化的第一个边沿的时刻，CLOCK_MONOTONIC
+    unsigned int key;                   // 按键序号 0~3
+    unsigned int pressed;               // 1 按下 0 松开
+};
 
-// 按键值 字符型 为了方便拷贝到用户空间
-static volatile char key_values[] = {
-	'0', '0', '0', '0'
+#define BTN_FIFO_SIZE       64          // 事件队列容量，须为 2 的幂
+
+static DECLARE_KFIFO(btn_fifo, struct btn_event, BTN_FIFO_SIZE);
+static DEFINE_SPINLOCK(btn_fifo_lock);  // 各按键的中断可能在不同 CPU 上同时放入，读者只有一个不需要加锁
+static DEFINE_MUTEX(btn_read_lock);     // kfifo 只允许一个读者，多个 read 之间串行
+static atomic_t btn_available = ATOMIC_INIT(1);    // /dev/gecBt 同一时刻只允许打开一次
+
+/**debugfs 计数器：/sys/kernel/debug/btn13/stats */
+enum {
+    BTN_STAT_IRQS = 0,
+    BTN_STAT_READS,
+    BTN_STAT_ERRORS,
+    BTN_STAT_DROPPED,                   // 队列满丢弃的事件数
+    BTN_STAT_BOUNCES,                   // 消抖定时器等待中又来的边沿数
+    BTN_STAT_GLITCHES,                  // 定时器到期时电平与上次报告相同(短脉冲干扰)的次数
+    BTN_STAT_NUM
 };
+static const char *const btn_stat_names[BTN_STAT_NUM] = {
+    "irqs", "reads", "errors", "dropped", "bounces", "glitches"
+};
+static struct drv_stats btn_stats;
 
 static int btn_open(struct inode *inode, struct file *pFile);
 static int btn_close(struct inode *inode, struct file *pFile);
@@ -58,6 +107,7 @@ static ssize_t btn_read(struct file *pFile, char __user *buf, size_t count, loff
 static int __devinit gec6818_buttons_probe(struct platform_device *pdev);
 static int __devexit gec6818_buttons_remove(struct platform_device *dev);
 static irqreturn_t btnIRQCallBack(int irq, void *dev_id);
+static void btnDebounceTimer(unsigned long data);
 
 /**文件操作集 */
 static struct file_operations dev_fops = {
@@ -88,12 +138,17 @@ static struct platform_driver gec6818_buttons_driver = {
 static int __init btnDrvInit(void)
 {
 	int ret;
+
+	INIT_KFIFO(btn_fifo);
 	ret = platform_driver_register(&gec6818_buttons_driver);
+	if (ret == 0)
+		drv_stats_init(&btn_stats, "btn13", btn_stat_names, BTN_STAT_NUM);
 	return ret;
 }
 
 static void __exit btnDrvExit(void)
 {
+    drv_stats_exit(&btn_stats);
     platform_driver_unregister(&gec6818_buttons_driver);
 }
 
@@ -104,15 +159,31 @@ static int btn_open(struct inode *inode, struct file *pFile)
     int err = 0;
     int tempIRQ;
 
-    /**1. 初始化等待队列 */
-    init_waitqueue_head(&button_waitq);
+    /**0. 中断和事件队列只有一份，同一时刻只允许一个进程打开，
+     *    否则第二次打开会清空正在使用的队列，再因中断已被占用而失败 */
+    if (!atomic_dec_and_test(&btn_available)) {
+        atomic_inc(&btn_available);
+        return -EBUSY;
+    }
+
+    /**1. 清空上次打开时剩下的事件 */
+    mutex_lock(&btn_read_lock);
+    kfifo_reset(&btn_fifo);
+    mutex_unlock(&btn_read_lock);
+
+    /**1.1 按引脚电平初始化按键状态：已独占设备，中断尚未申请，上次关闭时
+     *     消抖定时器已停止，没有 btnDebounceTimer 在比较 keyValues */
+    for (i = 0; i < BTN_SIZE; i++) {
+        if (!buttons[i].irq)
+            continue;
+        buttons[i].bouncing = 0;
+        keyValues[i] = !gpio_get_value(buttons[i].gpio);
+    }
 
     /**2. 将获取到的中断号注册到内核 */
     for (i = 0; i < BTN_SIZE; i++){
         
-        // 打印调试信息
-        printk(KERN_INFO "buttons:[%d], irq is %d.", i, buttons[i].irq);
-	    printk("<0>\n");
+        pr_debug("buttons:[%d], irq is %d\n", i, buttons[i].irq);
 
         // 如果中断号为0，直接调出循环
         if (!buttons[i].irq) {
@@ -141,8 +212,11 @@ static int btn_open(struct inode *inode, struct file *pFile)
 			tempIRQ = buttons[i].irq;
 			disable_irq(tempIRQ);
 			free_irq(tempIRQ, (void *)&buttons[i]);
+			del_timer_sync(&buttons[i].timer);
+			buttons[i].bouncing = 0;
       
 		}
+		atomic_inc(&btn_available);
 		return -EBUSY;
 	}
     return 0;
@@ -159,38 +233,59 @@ static int btn_close(struct inode *inode, struct file *pFile)
         }
 		irq = buttons[i].irq;
 		free_irq(irq, (void *)&buttons[i]);
+		del_timer_sync(&buttons[i].timer);     // 中断已释放，不会再重新启动
+		buttons[i].bouncing = 0;
 	}
+    atomic_inc(&btn_available);
     return 0;
 }
 
+/**
+ * @brief 队列中有事件时可读
+ */
 static unsigned int btn_poll( struct file *file, struct poll_table_struct *wait)
 {
-    return 0;
+    poll_wait(file, &button_waitq, wait);
+    return kfifo_is_empty(&btn_fifo) ? 0 : (POLLIN | POLLRDNORM);
 }
 
+/**
+ * @brief 取出按键事件
+ * @param count 至少为 sizeof(struct btn_event)，一次最多取出 count / sizeof(struct btn_event) 个
+ * @return 读到的字节数；队列为空时阻塞，O_NONBLOCK 时返回 -EAGAIN
+ */
 static ssize_t btn_read(struct file *pFile, char __user *buf, size_t count, loff_t *ppos)
 {
-    int i;
-    unsigned long err;
-
-    // ev_press为1，唤醒进程；为0，进入休眠
-    wait_event_interruptible(button_waitq, ev_press);
+    unsigned int copied;
+    int ret;
 
-    for(i = 0; i < BTN_SIZE; i++){
-        key_values[i] += keyValues[i];
+    if (count < sizeof(struct btn_event))
+        return -EINVAL;
+
+    if (mutex_lock_interruptible(&btn_read_lock))
+        return -ERESTARTSYS;
+
+    // 队列为空，当前读进程进入等待队列并且进入睡眠状态，让出 CPU
+    while (kfifo_is_empty(&btn_fifo)) {
+        mutex_unlock(&btn_read_lock);
+        if (pFile->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(button_waitq, !kfifo_is_empty(&btn_fifo)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&btn_read_lock))
+            return -ERESTARTSYS;
     }
 
-    err = copy_to_user((void *)buf, (const void *)(&key_values),
-        min(sizeof(key_values), count));
+    ret = kfifo_to_user(&btn_fifo, buf, count, &copied);
+    mutex_unlock(&btn_read_lock);
 
-    ev_press = 0;
-
-    // 每次读取按键值后，清零
-    for(i = 0; i < BTN_SIZE; i++) {
-        key_values[i] = '0';
+    if (ret != 0) {
+        drv_stats_inc(&btn_stats, BTN_STAT_ERRORS);
+        return ret;
     }
-
-    return err ? -EFAULT : min(sizeof(key_values), count);;
+    drv_stats_inc(&btn_stats, BTN_STAT_READS);
+    trace_btn13_read(DEV_NAME, -1, (int)copied);
+    return copied;
 }
 
 static int __devinit gec6818_buttons_probe(struct platform_device *pdev)
@@ -208,6 +303,8 @@ static int __devinit gec6818_buttons_probe(struct platform_device *pdev)
             buttons[i].irq = pBtnResource->start;
             buttons[i].name = pBtnResource->name;
             buttons[i].number = i;
+            buttons[i].gpio = buttons[i].irq - IRQ_GPIO_START;     // GPIO 中断号与引脚号一一对应
+            setup_timer(&buttons[i].timer, btnDebounceTimer, (unsigned long)&buttons[i]);
         }
     }
 
@@ -223,23 +320,59 @@ static int __devexit gec6818_buttons_remove(struct platform_device *dev)
 	return 0;
 }
 
+/**
+ * @brief 按键的边沿中断，只记录这一串抖动的开始时刻并(重新)启动消抖定时器，
+ *        抖动期间每个边沿都把到期时间推迟 debounce_ms
+ */
 static irqreturn_t btnIRQCallBack(int irq, void *dev_id)
 {
     TButtonDesc_t *pBtnData = (TButtonDesc_t *)dev_id;
+    unsigned int ms = min_t(unsigned int, ACCESS_ONCE(debounce_ms), BTN_DEBOUNCE_MAX_MS);
 
-    /**按键的键值赋值 */
-    keyValues[pBtnData->number] = !keyValues[pBtnData->number];
-
-    /**按键按下的标志位 */
-    ev_press = 1;
+    drv_stats_inc(&btn_stats, BTN_STAT_IRQS);
+    trace_btn13_irq(DEV_NAME, irq, gpio_get_value(pBtnData->gpio));
 
-    /**唤醒进程 */
-	wake_up_interruptible(&button_waitq);
+    if (!pBtnData->bouncing) {
+        pBtnData->edge_ns = ktime_to_ns(ktime_get());
+        pBtnData->bouncing = 1;
+    }
+    if (mod_timer(&pBtnData->timer, jiffies + msecs_to_jiffies(ms)))
+        drv_stats_inc(&btn_stats, BTN_STAT_BOUNCES);
 
     // IRQ_HANDLED已经捕获到中断信号，并且以正确处理
     return IRQ_HANDLED;
 }
 
+/**
+ * @brief 消抖定时器到期，引脚已稳定 debounce_ms，读取电平，状态变化时放入事件并唤醒读者
+ */
+static void btnDebounceTimer(unsigned long data)
+{
+    TButtonDesc_t *pBtnData = (TButtonDesc_t *)data;
+    struct btn_event ev;
+    int pressed = !gpio_get_value(pBtnData->gpio);
+
+    pBtnData->bouncing = 0;
+    if (pressed == keyValues[pBtnData->number]) {
+        drv_stats_inc(&btn_stats, BTN_STAT_GLITCHES);
+        return;
+    }
+    keyValues[pBtnData->number] = pressed;
+    trace_btn13_debounce(DEV_NAME, pBtnData->irq, pressed);
+
+    /**放入事件队列，队列满时丢弃最新的事件 */
+    ev.timestamp_ns = pBtnData->edge_ns;
+    ev.key = pBtnData->number;
+    ev.pressed = pressed;
+    if (kfifo_in_spinlocked(&btn_fifo, &ev, 1, &btn_fifo_lock) == 0) {
+        drv_stats_inc(&btn_stats, BTN_STAT_DROPPED);
+        return;
+    }
+
+    /**唤醒进程 */
+    wake_up_interruptible(&button_waitq);
+}
+
 module_init(btnDrvInit);
 module_exit(btnDrvExit);
 MODULE_AUTHOR("lium <123456@qq.com>");
@@ -250,4 +383,19 @@ MODULE_VERSION("2025-10-02_V1.0.1");
  * 改动历史纪录：
  * Revision 1.0, 2025-10-05, lium
  * describe: 初始创建.
+ * Revision 1.1, 2026-10-17, lium
+ * describe: 去掉 btn_open 中逐个中断的 printk，中断与读取记录为 btn13_irq/btn13_read
+ *           跟踪点，增加 debugfs 计数器 /sys/kernel/debug/btn13/stats.
+ * Revision 1.2, 2026-10-17, lium
+ * describe: 中断把 {按键, 按下/松开, 时间戳} 放入 kfifo，不再只置一个标志而合并或丢失按键；
+ *           read 一次取出多个事件，btn_poll 在队列非空时返回 POLLIN.
+ * Revision 1.3, 2026-10-17, lium
+ * describe: 每个按键一个消抖定时器，边沿只重新计时，到期时读取引脚电平，
+ *           与上次报告的状态不同才产生事件，一次按下只唤醒一次；消抖时间由模块参数
+ *           debounce_ms 设置；按键状态在打开时按引脚初始化，不再每个中断翻转.
+ * Revision 1.4, 2026-10-17, lium
+ * describe: 同一时刻只允许打开一次，第二次打开返回 -EBUSY，不再清空正在使用的事件队列.
+ * Revision 1.5, 2026-10-17, lium
+ * describe: 按键状态只在独占设备之后、申请中断之前按引脚初始化，被拒绝的打开
+ *           不再改写正在使用的消抖状态.
  *************************************************************************/
\ No newline at end of file
@@ -0,0 +1,104 @@
+﻿/*************************************************************************
+ *
+ *   文件名称: drv_stats.h
+ *   软件模块: 驱动调试计数
+ *   功    能: 在 debugfs 下为驱动创建 <name>/stats，按名称逐行列出各计数器，
+ *             向该文件写入任意内容则全部清零：
+ *             cat /sys/kernel/debug/<name>/stats
+ *             热路径上只做 atomic_inc，不打印；内核没有打开 CONFIG_DEBUG_FS 时
+ *             计数照常进行，只是没有文件可看。
+ *
+ ************************************************************************/
+#ifndef DRV_STATS_H_
+#define DRV_STATS_H_
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/err.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define DRV_STATS_MAX   8               // 每个驱动最多的计数器个数
+
+struct drv_stats {
+    struct dentry *dir;                 // /sys/kernel/debug/<name>
+    const char *const *names;           // 计数器名称，下标即计数器编号
+    int count;
+    atomic_t values[DRV_STATS_MAX];
+};
+
+static inline void drv_stats_inc(struct drv_stats *stats, int id)
+{
+    atomic_inc(&stats->values[id]);
+}
+
+static inline void drv_stats_add(struct drv_stats *stats, int id, int n)
+{
+    atomic_add(n, &stats->values[id]);
+}
+
+static int drv_stats_show(struct seq_file *m, void *v)
+{
+    struct drv_stats *stats = m->private;
+    int i;
+
+    for (i = 0; i < stats->count; i++)
+        seq_printf(m, "%-16s %u\n", stats->names[i], (unsigned int)atomic_read(&stats->values[i]));
+    return 0;
+}
+
+static int drv_stats_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, drv_stats_show, inode->i_private);
+}
+
+static ssize_t drv_stats_write(struct file *file, const char __user *buf, size_t len, loff_t *ppos)
+{
+    struct drv_stats *stats = ((struct seq_file *)file->private_data)->private;
+    int i;
+
+    for (i = 0; i < stats->count; i++)
+        atomic_set(&stats->values[i], 0);
+    return len;
+}
+
+static const struct file_operations drv_stats_fops = {
+    .owner      = THIS_MODULE,
+    .open       = drv_stats_open,
+    .read       = seq_read,
+    .write      = drv_stats_write,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
+
+/**
+ * @brief 创建 /sys/kernel/debug/<name>/stats，失败不影响驱动本身
+ * @param names 计数器名称数组，count 个
+ */
+static void drv_stats_init(struct drv_stats *stats, const char *name,
+                           const char *const *names, int count)
+{
+    int i;
+
+    stats->names = names;
+    stats->count = min(count, DRV_STATS_MAX);
+    for (i = 0; i < DRV_STATS_MAX; i++)
+        atomic_set(&stats->values[i], 0);
+
+    stats->dir = debugfs_create_dir(name, NULL);
+    if (IS_ERR_OR_NULL(stats->dir)) {
+        stats->dir = NULL;
+        return;
+    }
+    debugfs_create_file("stats", 0644, stats->dir, stats, &drv_stats_fops);
+}
+
+static void drv_stats_exit(struct drv_stats *stats)
+{
+    debugfs_remove_recursive(stats->dir);
+    stats->dir = NULL;
+}
+
+#endif  /* DRV_STATS_H_ */